@@ -1,5 +1,7 @@
 #include "aligned-mem-pool.h"
 
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 
 using namespace dynet;
@@ -15,15 +17,23 @@ void* InternalMemoryPool::allocate(size_t n) {
 }
 
 void InternalMemoryPool::sys_alloc(size_t cap) {
+  used = 0;
   capacity = a->round_up_align(cap);
+  // an empty pool only grows when memory is first requested from it
+  if (capacity == 0) {
+    mem = nullptr;
+    return;
+  }
   mem = a->malloc(capacity);
   if (mem == NULL)
     DYNET_RUNTIME_ERR(name << " failed to allocate " << capacity);
-  used = 0;
 }
 
-AlignedMemoryPool::AlignedMemoryPool(const std::string &name, size_t cap, MemAllocator *a) : name(name), current(0), cap(cap), a(a) {
-  DYNET_ASSERT(cap > 0, "Attempt to allocate memory of size 0 in AlignedMemoryPool");
+// the number of graphs in a row that must use at most half of a pool that
+// grew before it shrinks back
+static const unsigned kShrinkAfterFrees = 8;
+
+AlignedMemoryPool::AlignedMemoryPool(const std::string &name, size_t cap, MemAllocator *a) : name(name), current(0), cap(cap), initial_cap(cap), peak(0), free_peak(0), recent_peak(0), num_small_frees(0), a(a) {
   pools.push_back(new InternalMemoryPool(name, cap, a));
 }
 AlignedMemoryPool::~AlignedMemoryPool() {
@@ -32,23 +42,54 @@ AlignedMemoryPool::~AlignedMemoryPool() {
 
 void* AlignedMemoryPool::allocate(size_t n) {
   void *res = pools[current]->allocate(n);
-  if (res == 0) {
-    // round up to the nearest multiple of cap
-    pools.push_back(new InternalMemoryPool(name, ((n+cap-1)/cap)*cap, a));
-    current++;
+  if (res != 0) return res;
+  // the segments after the current one are empty, and are left over from
+  // before a set_used(); use the first one that is large enough
+  while (++current < (int)pools.size()) {
     res = pools[current]->allocate(n);
+    if (res != 0) return res;
   }
-  return res;
+  // round up to the nearest multiple of cap
+  pools.push_back(new InternalMemoryPool(name, cap > 0 ? ((n+cap-1)/cap)*cap : n, a));
+  return pools[current]->allocate(n);
 }
 
 void AlignedMemoryPool::free() {
-  if (current > 0) {
+  const size_t graph_used = std::max(free_peak, used());
+  peak = std::max(peak, graph_used);
+  free_peak = 0;
+  size_t new_cap = 0;
+  bool replace = false;
+  if (pools.size() > 1) {
+    // replace the segments by a single one that holds all of them, so the
+    // pool keeps the memory it grew to without being fragmented
+    for (auto p : pools) { new_cap += p->get_capacity(); }
+    replace = true;
+    num_small_frees = 0;
+    recent_peak = 0;
+  } else if (pools[0]->get_capacity() > initial_cap) {
+    if (2 * graph_used > pools[0]->get_capacity()) {
+      num_small_frees = 0;
+      recent_peak = 0;
+    } else {
+      recent_peak = std::max(recent_peak, graph_used);
+      // the last graphs fitted in half the pool, shrink it back to what
+      // they needed
+      if (++num_small_frees >= kShrinkAfterFrees) {
+        new_cap = std::max(initial_cap, a->round_up_align(recent_peak));
+        replace = true;
+        num_small_frees = 0;
+        recent_peak = 0;
+      }
+    }
+  }
+  if (replace) {
     for (auto p : pools) { delete p; }
     pools.clear();
-    pools.push_back(new InternalMemoryPool(name, cap * (current+1), a));
-    cap = cap * (current + 1);
-    current = 0;
+    pools.push_back(new InternalMemoryPool(name, new_cap, a));
+    cap = new_cap;
   }
+  current = 0;
   pools[0]->free();
 }
 
@@ -57,7 +98,7 @@ void AlignedMemoryPool::zero_allocated_memory() {
 }
 
 size_t AlignedMemoryPool::used() {
-  if (current == 0) {
+  if (pools.size() == 1) {
     return pools[0]->used;
   }
   size_t res = 0;
@@ -65,19 +106,153 @@ size_t AlignedMemoryPool::used() {
   return res;
 }
 
+size_t AlignedMemoryPool::peak_used() {
+  return std::max(peak, used());
+}
+
+size_t AlignedMemoryPool::capacity() const {
+  size_t res = 0;
+  for (auto p : pools) { res += p->get_capacity(); }
+  return res;
+}
+
 void AlignedMemoryPool::set_used(size_t s) {
-  if(s != pools.back()->used) {
-    DYNET_ARG_CHECK(pools.size() == 1, "Dynet does not support both dynamic increasing of memory pool size, and automatic batching or memory checkpointing. If you want to use automatic batching or checkpointing, please pre-allocate enough memory using the --dynet-mem command line option (details http://dynet.readthedocs.io/en/latest/commandline.html).");
-    pools[0]->used = s;
+  peak = std::max(peak, used());
+  free_peak = std::max(free_peak, used());
+  // Allocations after s was returned by used() only happened in the segment
+  // that was current then and in later ones, so walking the segments in
+  // order finds that segment and its use at the time. The later segments
+  // are emptied but kept, so that they are reused by the next allocations.
+  int c = 0;
+  while (s > pools[c]->used) {
+    s -= pools[c]->used;
+    c++;
+    DYNET_ARG_CHECK(c <= current, "Attempt to set the memory used by " << name << " to a larger value than used()");
+  }
+  pools[c]->used = s;
+  for (int i = c + 1; i <= current; ++i)
+    pools[i]->used = 0;
+  current = c;
+}
+
+bool AlignedMemoryPool::release_top(void* p, size_t n) {
+  n = a->round_up_align(n);
+  InternalMemoryPool* pool = pools[current];
+  if (pool->used < n || static_cast<char*>(pool->top()) - n != p)
+    return false;
+  peak = std::max(peak, used());
+  free_peak = std::max(free_peak, used());
+  pool->used -= n;
+  // the previous segment is filled first again
+  while (current > 0 && pools[current]->used == 0)
+    --current;
+  return true;
+}
+
+void RecyclingMemoryPool::insert_block(char* p, size_t n) {
+  free_blocks.insert(std::make_pair(n, p));
+  free_addresses[p] = n;
+}
+
+void RecyclingMemoryPool::erase_block(char* p, size_t n) {
+  auto range = free_blocks.equal_range(n);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == p) {
+      free_blocks.erase(it);
+      break;
+    }
   }
-  // TODO: This is disabled for now, because it would require freeing all the memory pools to do properly
-  // int c = 0;
-  // while (s > pools[c]->used) {
-  //   s -= pools[c]->used;
-  //   c++;
-  //   DYNET_ASSERT(c <= current, "attempt to set_used to a larger value than used().");
-  // }
-  // // s <= pools[c]->used
-  // pools[c]->used = s;
-  // current = c;
+  free_addresses.erase(p);
+}
+
+void* RecyclingMemoryPool::allocate(size_t n) {
+  n = pool->round_up_align(n);
+  auto it = free_blocks.lower_bound(n);
+  if (it == free_blocks.end())
+    return pool->allocate(n);
+  char* res = it->second;
+  size_t rest = it->first - n;
+  erase_block(res, it->first);
+  if (rest > 0)
+    insert_block(res + n, rest);
+  return res;
+}
+
+void RecyclingMemoryPool::release(void* p, size_t n) {
+  n = pool->round_up_align(n);
+  if (p == nullptr || n == 0) return;
+  char* begin = static_cast<char*>(p);
+  // merge with the free block that ends where this one begins, and with the
+  // one that begins where it ends. Blocks of two segments of the pool are
+  // only adjacent if the segments are contiguous, and all the segments are
+  // kept until the pool is freed, when the free list is cleared.
+  auto next = free_addresses.lower_bound(begin);
+  if (next != free_addresses.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == begin) {
+      begin = prev->first;
+      n += prev->second;
+      erase_block(prev->first, prev->second);
+    }
+  }
+  next = free_addresses.find(begin + n);
+  if (next != free_addresses.end()) {
+    const size_t next_n = next->second;
+    erase_block(begin + n, next_n);
+    n += next_n;
+  }
+  insert_block(begin, n);
+}
+
+size_t SizeClassMemoryPool::size_class(size_t n) const {
+  if (n <= 1) return pool->round_up_align(n);
+  size_t step = 1;
+  while (step * 8 < n) step *= 2;
+  return pool->round_up_align((n + step - 1) / step * step);
+}
+
+void* SizeClassMemoryPool::allocate(size_t n) {
+  n = size_class(n);
+  std::lock_guard<std::mutex> lk(m);
+  auto it = free_blocks.find(n);
+  if (it != free_blocks.end() && !it->second.empty()) {
+    void* res = it->second.back();
+    it->second.pop_back();
+    free_ends.erase(static_cast<char*>(res) + n);
+    released_bytes -= n;
+    return res;
+  }
+  void* res = pool->allocate(n);
+  sizes[res] = n;
+  return res;
+}
+
+void SizeClassMemoryPool::release(void* p) {
+  std::lock_guard<std::mutex> lk(m);
+  auto it = sizes.find(p);
+  if (it == sizes.end()) return;
+  void* end = static_cast<char*>(p) + it->second;
+  if (free_ends.count(end)) return;
+  free_blocks[it->second].push_back(p);
+  free_ends[end] = p;
+  released_bytes += it->second;
+}
+
+size_t SizeClassMemoryPool::trim() {
+  std::lock_guard<std::mutex> lk(m);
+  size_t res = 0;
+  auto it = free_ends.find(pool->top());
+  while (it != free_ends.end()) {
+    void* p = it->second;
+    const size_t n = sizes[p];
+    if (!pool->release_top(p, n)) break;
+    auto & blocks = free_blocks[n];
+    blocks.erase(std::find(blocks.begin(), blocks.end(), p));
+    free_ends.erase(it);
+    sizes.erase(p);
+    released_bytes -= n;
+    res += n;
+    it = free_ends.find(pool->top());
+  }
+  return res;
 }
@@ -2,6 +2,10 @@
 #define DYNET_ALIGNED_MEM_POOL_H
 
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "dynet/mem.h"
 #include "dynet/globals.h"
 #include "dynet/except.h"
@@ -12,7 +16,9 @@ class InternalMemoryPool {
  public:
   explicit InternalMemoryPool(const std::string & name, size_t cap, MemAllocator* a) : name(name), a(a) {
     sys_alloc(cap);
-    zero_all();
+    // memory that is already zero is left to be touched first by the
+    // threads that use it
+    if (!a->malloc_zeroes()) zero_all();
   }
 
   ~InternalMemoryPool() {
@@ -31,12 +37,15 @@ class InternalMemoryPool {
     a->zero(mem, used);
   }
 
+  size_t get_capacity() const { return capacity; }
+  void* top() const { return static_cast<char*>(mem) + used; }
+
   size_t used;
  private:
   void sys_alloc(size_t cap);
 
   void zero_all() {
-    a->zero(mem, capacity);
+    if (capacity > 0) a->zero(mem, capacity);
   }
   std::string name;
   size_t capacity;
@@ -51,21 +60,122 @@ class AlignedMemoryPool {
 
     void* allocate(size_t n);
 
+    /**
+     * \brief Frees all the memory allocated from the pool
+     * \details Segments added when the pool grew are merged into one. A pool
+     *          that grew beyond its initial capacity shrinks back once
+     *          several graphs in a row have used at most half of it, so a
+     *          single large graph does not hold its memory forever.
+     */
     void free();
 
     void zero_allocated_memory();
 
     size_t used();
     void set_used(size_t s);
+    /**
+     * \brief The largest number of bytes used since the pool was created or
+     *        reset_peak() was called
+     */
+    size_t peak_used();
+    void reset_peak() { peak = used(); }
+    /**
+     * \brief The number of bytes held by the pool
+     */
+    size_t capacity() const;
+
+    size_t round_up_align(size_t n) const { return a->round_up_align(n); }
+
+    /**
+     * \brief The end of the memory allocated last
+     */
+    void* top() const { return pools[current]->top(); }
+    /**
+     * \brief Gives back the n bytes at p, if they were allocated last
+     * \return Whether the memory was given back
+     */
+    bool release_top(void* p, size_t n);
 
   private:
     std::string name;
     std::vector<InternalMemoryPool *> pools;
     int current;
     size_t cap;
+    size_t initial_cap; // the pool never shrinks below its initial capacity
+    size_t peak; // the use only drops in free() and set_used(), which update it
+    size_t free_peak; // the largest use since the last free()
+    size_t recent_peak; // the largest use of the last num_small_frees graphs
+    unsigned num_small_frees; // graphs in a row that used at most half the pool
     MemAllocator* a;
 };
 
+/**
+ * \brief An allocator on top of an AlignedMemoryPool that reuses released memory
+ * \details Released blocks are kept in a free list ordered by size. An
+ *          allocation takes the smallest free block that is large enough,
+ *          returns the rest of it to the free list, and only grows the
+ *          underlying pool when no block fits. A released block is merged
+ *          with the free blocks right before and after it, so that varying
+ *          sizes do not fragment the memory. The free list must be cleared
+ *          whenever the underlying pool is freed.
+ */
+class RecyclingMemoryPool {
+  public:
+    explicit RecyclingMemoryPool(AlignedMemoryPool *pool) : pool(pool) {}
+
+    void* allocate(size_t n);
+    void release(void* p, size_t n);
+
+    void clear() { free_blocks.clear(); free_addresses.clear(); }
+
+  private:
+    void insert_block(char* p, size_t n);
+    void erase_block(char* p, size_t n);
+
+    AlignedMemoryPool *pool;
+    std::multimap<size_t, char*> free_blocks; // by size
+    std::map<char*, size_t> free_addresses; // the same blocks, by address
+};
+
+/**
+ * \brief An allocator on top of an AlignedMemoryPool for memory that is
+ *        released in any order, like that of parameters
+ * \details Sizes are rounded up to one of four classes per power of two, so
+ *          that at most a quarter of a block is wasted. Released blocks are
+ *          kept in a free list per class, and reused by the next allocations
+ *          of the same class. trim() gives the released blocks at the end of
+ *          the underlying pool back to it, so that they can be used for any
+ *          size. Blocks are never moved.
+ */
+class SizeClassMemoryPool {
+  public:
+    explicit SizeClassMemoryPool(AlignedMemoryPool *pool) : pool(pool), released_bytes(0) {}
+
+    void* allocate(size_t n);
+    /**
+     * \brief Releases a block returned by allocate(), other pointers are ignored
+     */
+    void release(void* p);
+    /**
+     * \brief Gives the released blocks at the end of the pool back to it
+     * \return The number of bytes given back
+     */
+    size_t trim();
+    /**
+     * \brief The number of bytes in released blocks
+     */
+    size_t released() const { return released_bytes; }
+    size_t size_class(size_t n) const;
+
+  private:
+    AlignedMemoryPool *pool;
+    std::unordered_map<void*, size_t> sizes; // sizes of the blocks that are allocated or released
+    std::map<size_t, std::vector<void*> > free_blocks; // released blocks of each class
+    std::map<void*, void*> free_ends; // start of the released blocks, by their end
+    size_t released_bytes;
+    std::mutex m;
+};
+
 } // namespace dynet
 
 #endif
@@ -75,10 +75,13 @@ vector<Device*> initialize_gpu(DynetParams& params) {
   }
   stable_sort(gpus.begin(), gpus.end(), [&](int a, int b) -> bool { return gpu_free_mem[a] > gpu_free_mem[b]; });
   gpus.resize(params.requested_gpus);
+  DeviceMempoolSizes mem_sizes(params.mem_descriptor);
+  if (params.inference)
+    mem_sizes.used[(int)DeviceMempool::DEDFS] = 0;
   cerr << "[dynet] Device(s) selected:";
   for (int i = 0; i < params.requested_gpus; ++i) {
     cerr << ' ' << gpus[i];
-    Device* d = new Device_GPU(gpudevices.size(), params.mem_descriptor, gpus[i]);
+    Device* d = new Device_GPU(gpudevices.size(), mem_sizes, gpus[i]);
     gpudevices.push_back(d);
   }
   cerr << endl;
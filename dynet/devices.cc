@@ -2,6 +2,8 @@
 
 #include <boost/algorithm/string.hpp>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <unsupported/Eigen/CXX11/Tensor>
 
 #include "dynet/cuda.h"
@@ -47,29 +49,55 @@ Device::~Device() {}
 DeviceMempoolSizes Device::mark(ComputationGraph *cg) {
   cg->incremental_forward({cg, (VariableIndex)(cg->nodes.size() - 1)}); // needed so that we actually allocate the needed memory
   // for all existing nodes.
-  return DeviceMempoolSizes(pools[0]->used(), pools[1]->used(), pools[2]->used());
+  return DeviceMempoolSizes(pool(DeviceMempool::FXS)->used(), pool(DeviceMempool::DEDFS)->used(), pool(DeviceMempool::PS)->used());
 }
 
 void Device::revert(const DeviceMempoolSizes & cp) {
-  if(cp.used[0] > pools[0]->used())
-    DYNET_INVALID_ARG("Saved value greater than original value in Device::revert (" << cp.used[0] << " > " << pools[0]->used() << ")");
-  pools[0]->set_used(cp.used[0]);
-  if(cp.used[1] > pools[1]->used())
-    DYNET_INVALID_ARG("Saved value greater than original value in Device::revert (" << cp.used[1] << " > " << pools[1]->used() << ")");
-  pools[1]->set_used(cp.used[1]);
-  if(cp.used[2] > pools[2]->used())
-    DYNET_INVALID_ARG("Saved value greater than original value in Device::revert (" << cp.used[2] << " > " << pools[2]->used() << ")");
-  pools[2]->set_used(cp.used[2]);
+  for (int i = 0; i < 3; ++i) {
+    AlignedMemoryPool* p = pool((DeviceMempool)i);
+    if(cp.used[i] > p->used())
+      DYNET_INVALID_ARG("Saved value greater than original value in Device::revert (" << cp.used[i] << " > " << p->used() << ")");
+    p->set_used(cp.used[i]);
+  }
 }
 
 void Device::allocate_tensor(DeviceMempool mp, Tensor & tens) {
   DYNET_ASSERT(mp != DeviceMempool::NONE, "Attempt to allocate tensor for NONE DeviceMempool");
   DYNET_ASSERT(pools[(int)mp] != nullptr, "Attempt to allocate tensor for null DeviceMempool");
-  tens.v = (float*)pools[(int)mp]->allocate(tens.d.size() * sizeof(float));
+  if (mp == DeviceMempool::PS)
+    tens.v = (float*)param_pool->allocate(tens.d.size() * sizeof(float));
+  else
+    tens.v = (float*)pool(mp)->allocate(tens.d.size() * sizeof(float));
   DYNET_ASSERT(tens.v != nullptr, "Allocated tensor is zero");
   tens.mem_pool = mp;
 }
 
+void Device::free_tensor(DeviceMempool mp, Tensor & tens) {
+  DYNET_ASSERT(mp == DeviceMempool::PS, "Only tensors of the parameter pool can be freed individually");
+  if (tens.v != nullptr)
+    param_pool->release(tens.v);
+  tens.v = nullptr;
+}
+
+// the forward and backward pools of the devices for threads other than their
+// creator, freed when the thread exits
+struct ThreadPools {
+  unordered_map<const Device*, unique_ptr<AlignedMemoryPool> > fxs, dedfs;
+};
+static thread_local ThreadPools thread_pools;
+
+AlignedMemoryPool* Device::pool(DeviceMempool mp) {
+  if (mp == DeviceMempool::PS || this_thread::get_id() == owner)
+    return pools[(int)mp];
+  DYNET_ASSERT(mp != DeviceMempool::NONE, "Attempt to get the pool for NONE DeviceMempool");
+  auto & thread_pool = (mp == DeviceMempool::FXS ? thread_pools.fxs : thread_pools.dedfs)[this];
+  if (!thread_pool) {
+    const string name = (mp == DeviceMempool::FXS ? "thread forward memory" : "thread backward memory");
+    thread_pool.reset(new AlignedMemoryPool(name, (pool_sizes.used[(int)mp] << 20), mem));
+  }
+  return thread_pool.get();
+}
+
 #if HAVE_CUDA
 Device_GPU::Device_GPU(int my_id, const DeviceMempoolSizes & mbs, int device_id) :
   Device(my_id, DeviceType::GPU, &gpu_mem), cuda_device_id(device_id), gpu_mem(device_id) {
@@ -94,16 +122,18 @@ Device_GPU::Device_GPU(int my_id, const DeviceMempoolSizes & mbs, int device_id)
   edevice = new Eigen::GpuDevice(estream);
 
   // this is the big memory allocation.
+  pool_sizes = mbs;
   pools[0] = new AlignedMemoryPool("GPU forward memory", (mbs.used[0] << 20), &gpu_mem);
   pools[1] = new AlignedMemoryPool("GPU backward memory", (mbs.used[1] << 20), &gpu_mem);
   pools[2] = new AlignedMemoryPool("GPU parameter memory", (mbs.used[2] << 20), &gpu_mem);
+  param_pool.reset(new SizeClassMemoryPool(pools[2]));
 }
 
 Device_GPU::~Device_GPU() {}
 #endif
 
-Device_CPU::Device_CPU(int my_id, const DeviceMempoolSizes & mbs, bool shared) :
-  Device(my_id, DeviceType::CPU, &cpu_mem), shmem(mem) {
+Device_CPU::Device_CPU(int my_id, const DeviceMempoolSizes & mbs, bool shared, const CPUMemoryOptions & mem_opts) :
+  Device(my_id, DeviceType::CPU, &cpu_mem), cpu_mem(mem_opts), shmem(mem) {
   if (shared) shmem = new SharedAllocator();
   kSCALAR_MINUSONE = (float*) mem->malloc(sizeof(float));
   *kSCALAR_MINUSONE = -1;
@@ -116,9 +146,11 @@ Device_CPU::Device_CPU(int my_id, const DeviceMempoolSizes & mbs, bool shared) :
   edevice = new Eigen::DefaultDevice;
 
   // this is the big memory allocation.
+  pool_sizes = mbs;
   pools[0] = new AlignedMemoryPool("CPU forward memory", (mbs.used[0] << 20), &cpu_mem);
   pools[1] = new AlignedMemoryPool("CPU backward memory", (mbs.used[1] << 20), &cpu_mem);
   pools[2] = new AlignedMemoryPool("CPU parameter memory", (mbs.used[2] << 20), shmem);
+  param_pool.reset(new SizeClassMemoryPool(pools[2]));
 }
 
 Device_CPU::~Device_CPU() {}
@@ -1,7 +1,9 @@
 #ifndef DYNET_DEVICES_H
 #define DYNET_DEVICES_H
 
+#include <memory>
 #include <string>
+#include <thread>
 #include "dynet/aligned-mem-pool.h"
 #include "dynet/cuda.h"
 
@@ -30,7 +32,7 @@ struct DeviceMempoolSizes {
 
 class Device {
  protected:
-  Device(int i, DeviceType t, MemAllocator* m) : device_id(i), type(t), mem(m), pools(3, nullptr) {}
+  Device(int i, DeviceType t, MemAllocator* m) : device_id(i), type(t), mem(m), pools(3, nullptr), owner(std::this_thread::get_id()) {}
   Device(const Device&) = delete;
   Device& operator=(const Device&) = delete;
   virtual ~Device();
@@ -45,7 +47,35 @@ class Device {
   virtual DeviceMempoolSizes mark(ComputationGraph *cg);
   virtual void revert(const DeviceMempoolSizes & cp);
   void allocate_tensor(DeviceMempool mem_pool, Tensor & tensor);
+  /**
+   * \brief Releases the memory of a tensor of the parameter pool, so that it
+   *        can be reused by the next parameters of a similar size
+   * \details Tensors of the other pools are released all at once with their pool.
+   */
+  void free_tensor(DeviceMempool mem_pool, Tensor & tensor);
+  /**
+   * \brief Gives the released parameter memory at the end of the parameter
+   *        pool back to it, so that it can be reused for parameters of any size
+   * \return The number of bytes given back
+   */
+  size_t trim_parameter_memory() { return param_pool->trim(); }
+  /**
+   * \brief Get the memory pool used by the calling thread
+   * \details The parameter pool is shared. The thread that created the device
+   *          uses its forward and backward pools, and every other thread gets
+   *          its own forward and backward pools of the same initial sizes
+   *          when it first asks for them, so graphs in different threads do
+   *          not share memory.
+   *
+   * \param mp The memory pool
+   * \return The pool for the calling thread
+   */
+  AlignedMemoryPool* pool(DeviceMempool mp);
   std::vector<AlignedMemoryPool*> pools;
+  std::unique_ptr<SizeClassMemoryPool> param_pool; // allocates from the parameter pool
+ protected:
+  std::thread::id owner;
+  DeviceMempoolSizes pool_sizes; // initial sizes of the pools, in MB
 };
 
 #if HAVE_CUDA
@@ -68,7 +98,7 @@ class Device_GPU : public Device {
 class Device_CPU : public Device {
  public:
   typedef Eigen::DefaultDevice EigenDevice;
-  explicit Device_CPU(int my_id, const DeviceMempoolSizes & mb, bool shared);
+  explicit Device_CPU(int my_id, const DeviceMempoolSizes & mb, bool shared, const CPUMemoryOptions & mem_opts = CPUMemoryOptions());
   ~Device_CPU();
   CPUAllocator cpu_mem;
   Eigen::DefaultDevice* edevice;
@@ -1,11 +1,20 @@
 #include "dynet/dynet.h"
 
+#include <atomic>
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
 #include "dynet/exec.h"
 #include "dynet/nodes.h"
 #include "dynet/param-nodes.h"
 #include "dynet/aligned-mem-pool.h"
 #include "dynet/dynet-helper.h"
+#include "dynet/mem-stats.h"
 #include "dynet/expr.h"
+#include "dynet/profiler.h"
 
 using namespace std;
 
@@ -14,19 +23,37 @@ namespace dynet {
 float* kSCALAR_MINUSONE;
 float* kSCALAR_ONE;
 float* kSCALAR_ZERO;
-int n_hgs = 0;
-unsigned n_cumul_hgs = 0;
+// every thread can have one graph at a time, and graph ids are unique
+// across threads
+thread_local int n_hgs = 0;
+thread_local unsigned current_graph_id = 0;
+atomic<unsigned> n_cumul_hgs(0);
 
 int get_number_of_active_graphs() {return n_hgs;};
-unsigned get_current_graph_id() {return n_cumul_hgs;};
+unsigned get_current_graph_id() {return current_graph_id;};
 
 Node::~Node() {}
 size_t Node::aux_storage_size() const { return 0; }
+bool Node::for_inference() const { return cg_ != nullptr && cg_->is_inference_mode(); }
+
+string Node::type_name() const {
+  string name = typeid(*this).name();
+#ifdef __GNUG__
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+  if (status == 0 && demangled != nullptr) name = demangled;
+  free(demangled);
+#endif
+  if (name.compare(0, 7, "dynet::") == 0)
+    name = name.substr(7);
+  return name;
+}
 
 // perform the forward/backward passes in one or multiple calls
 // TODO: This is a lot of code for something simple. Can it be shortened?
 void Node::forward(const std::vector<const Tensor*>& xs,
                    Tensor& fx) const {
+  ProfileScope profile(this, ProfilePhase::forward, xs, fx);
   if (this->supports_multibatch() || fx.d.batch_elems() == 1) {
     forward_impl(xs, fx);
   } else {
@@ -57,6 +84,7 @@ void Node::backward(const std::vector<const Tensor*>& xs,
                     const Tensor& dEdf,
                     unsigned xs_i,
                     Tensor& dEdxi) const {
+  ProfileScope profile(this, ProfilePhase::backward, xs, fx);
   if (this->supports_multibatch() || fx.d.batch_elems() == 1) {
     backward_impl(xs, fx, dEdf, xs_i, dEdxi);
   } else {
@@ -109,18 +137,23 @@ void Node::autobatch_reshape_concatonly(const ComputationGraph & cg,
 ComputationGraph::ComputationGraph() {
   if(autobatch_flag) {
     ee = new BatchedExecutionEngine(*this);
+  } else if(exec_threads_flag > 1) {
+    ee = new ParallelExecutionEngine(*this, exec_threads_flag);
   } else {
     ee = new SimpleExecutionEngine(*this);
   }
   if (n_hgs > 0) {
-    cerr << "Memory allocator assumes only a single ComputationGraph at a time.\n";
+    cerr << "Memory allocator assumes only a single ComputationGraph at a time in each thread.\n";
     throw std::runtime_error("Attempted to create >1 CG");
   }
   ++n_hgs;
+  attached = true;
   immediate_compute = false;
   check_validity = false;
-  ++n_cumul_hgs;
-  graph_id = n_cumul_hgs;
+  inference_mode = inference_flag;
+  recompute = false;
+  graph_id = ++n_cumul_hgs;
+  current_graph_id = graph_id;
 }
 
 ComputationGraph::ComputationGraph(bool batched) {
@@ -130,30 +163,59 @@ ComputationGraph::ComputationGraph(bool batched) {
     ee = new SimpleExecutionEngine(*this);
   }
   if (n_hgs > 0) {
-    cerr << "Memory allocator assumes only a single ComputationGraph at a time.\n";
+    cerr << "Memory allocator assumes only a single ComputationGraph at a time in each thread.\n";
     throw std::runtime_error("Attempted to create >1 CG");
   }
   ++n_hgs;
+  attached = true;
   immediate_compute = false;
   check_validity = false;
-  ++n_cumul_hgs;
-  graph_id = n_cumul_hgs;
+  inference_mode = inference_flag;
+  recompute = false;
+  graph_id = ++n_cumul_hgs;
+  current_graph_id = graph_id;
 }
 
 ComputationGraph::~ComputationGraph() {
   this->clear();
   delete ee;
+  if (attached)
+    --n_hgs;
+  count_graph_for_memory_log();
+}
+
+void ComputationGraph::detach_from_thread() {
+  if (!attached || current_graph_id != graph_id)
+    DYNET_RUNTIME_ERR("Only the current graph of a thread can be detached from it");
+  attached = false;
   --n_hgs;
+  current_graph_id = 0;
+}
+
+void ComputationGraph::attach_to_thread() {
+  if (attached)
+    DYNET_RUNTIME_ERR("Attempted to attach a graph that was not detached from its thread");
+  if (n_hgs > 0)
+    DYNET_RUNTIME_ERR("Attempted to attach a graph to a thread that already has one");
+  attached = true;
+  ++n_hgs;
+  current_graph_id = graph_id;
 }
 
 void ComputationGraph::clear() {
   parameter_nodes.clear();
-  for (auto n : nodes) delete n;
+  segment_starts.clear();
+  for (auto n : nodes) delete_node(n);
   nodes.clear();
+  arena.reset();
 
   ee->invalidate();
 }
 
+void ComputationGraph::delete_node(Node* node) {
+  node->~Node();
+}
+
 CGCheckpoint ComputationGraph::_get_checkpoint() {
   CGCheckpoint p;
   p.device_mem_checkpoint = default_device->mark(this);
@@ -165,14 +227,19 @@ CGCheckpoint ComputationGraph::_get_checkpoint() {
 void ComputationGraph::_revert(CGCheckpoint p) {
   default_device->revert(p.device_mem_checkpoint);
   // clear all nodes at position >= p.node_idx
+  // their memory is only reclaimed by clear()
   if ((int)nodes.size() > p.node_idx) {
-    nodes.resize(p.node_idx); // TODO verify deletion of nodes.
+    for (size_t i = p.node_idx; i < nodes.size(); ++i)
+      delete_node(nodes[i]);
+    nodes.resize(p.node_idx);
     ee->invalidate(p.node_idx - 1); // clear precomputed forward values
   }
   // clear all parameter nodes at position >= p.par_node_idx
   if ((int)parameter_nodes.size() > p.par_node_idx) {
     parameter_nodes.resize(p.par_node_idx);
   }
+  while (!segment_starts.empty() && (int)segment_starts.back() >= p.node_idx)
+    segment_starts.pop_back();
 }
 
 void ComputationGraph::checkpoint() {
@@ -193,43 +260,42 @@ Dim& ComputationGraph::get_dimension(VariableIndex index) const {
 
 VariableIndex ComputationGraph::add_input(real s) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new ScalarInputNode(s));
+  nodes.push_back(new_node<ScalarInputNode>(s));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_input(const real* ps) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new ScalarInputNode(ps));
+  nodes.push_back(new_node<ScalarInputNode>(ps));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_input(const Dim& d, const vector<float>& pm) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new InputNode(d, pm));
+  nodes.push_back(new_node<InputNode>(d, pm));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_input(const Dim& d, const vector<float>* pm) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new InputNode(d, pm));
+  nodes.push_back(new_node<InputNode>(d, pm));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_input(const Dim& d, const vector<unsigned int>& ids, const vector<float>& data, float defdata) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new SparseInputNode(d, ids, data, defdata));
+  nodes.push_back(new_node<SparseInputNode>(d, ids, data, defdata));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_parameters(Parameter p) {
   VariableIndex new_node_index(nodes.size());
-  ParameterNode* new_node = new ParameterNode(p);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<ParameterNode>(p));
   parameter_nodes.push_back(new_node_index);
   set_dim_for_new_node(new_node_index);
   return new_node_index;
@@ -237,8 +303,7 @@ VariableIndex ComputationGraph::add_parameters(Parameter p) {
 
 VariableIndex ComputationGraph::add_parameters(LookupParameter p) {
   VariableIndex new_node_index(nodes.size());
-  ParameterNode* new_node = new ParameterNode(p);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<ParameterNode>(p));
   parameter_nodes.push_back(new_node_index);
   set_dim_for_new_node(new_node_index);
   return new_node_index;
@@ -246,24 +311,21 @@ VariableIndex ComputationGraph::add_parameters(LookupParameter p) {
 
 VariableIndex ComputationGraph::add_const_parameters(Parameter p) {
   VariableIndex new_node_index(nodes.size());
-  ConstParameterNode* new_node = new ConstParameterNode(p);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<ConstParameterNode>(p));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_const_parameters(LookupParameter p) {
   VariableIndex new_node_index(nodes.size());
-  ConstParameterNode* new_node = new ConstParameterNode(p);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<ConstParameterNode>(p));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_lookup(LookupParameter p, const unsigned* pindex) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, pindex);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, pindex));
   parameter_nodes.push_back(new_node_index);
   set_dim_for_new_node(new_node_index);
   return new_node_index;
@@ -271,8 +333,7 @@ VariableIndex ComputationGraph::add_lookup(LookupParameter p, const unsigned* pi
 
 VariableIndex ComputationGraph::add_lookup(LookupParameter p, unsigned index) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, index);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, index));
   parameter_nodes.push_back(new_node_index);
   set_dim_for_new_node(new_node_index);
   return new_node_index;
@@ -280,8 +341,7 @@ VariableIndex ComputationGraph::add_lookup(LookupParameter p, unsigned index) {
 
 VariableIndex ComputationGraph::add_lookup(LookupParameter p, const std::vector<unsigned>& indices) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, indices);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, indices));
   parameter_nodes.push_back(new_node_index);
   set_dim_for_new_node(new_node_index);
   return new_node_index;
@@ -289,8 +349,7 @@ VariableIndex ComputationGraph::add_lookup(LookupParameter p, const std::vector<
 
 VariableIndex ComputationGraph::add_lookup(LookupParameter p, const std::vector<unsigned>* indices) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, indices);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, indices));
   parameter_nodes.push_back(new_node_index);
   set_dim_for_new_node(new_node_index);
   return new_node_index;
@@ -299,34 +358,30 @@ VariableIndex ComputationGraph::add_lookup(LookupParameter p, const std::vector<
 
 VariableIndex ComputationGraph::add_const_lookup(LookupParameter p, const unsigned* pindex) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, pindex);
   // get rid of the following in favor of using parameter_nodes to see the needs_derivative
   // expression
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, pindex));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_const_lookup(LookupParameter p, unsigned index) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, index);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, index));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_const_lookup(LookupParameter p, const std::vector<unsigned>& indices) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, indices);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, indices));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
 
 VariableIndex ComputationGraph::add_const_lookup(LookupParameter p, const std::vector<unsigned>* indices) {
   VariableIndex new_node_index(nodes.size());
-  LookupNode* new_node = new LookupNode(p, indices);
-  nodes.push_back(new_node);
+  nodes.push_back(new_node<LookupNode>(p, indices));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
@@ -357,6 +412,8 @@ const Tensor& ComputationGraph::incremental_forward(const expr::Expression& last
 const Tensor& ComputationGraph::forward(const expr::Expression& last) { return ee->forward(last.i); }
 const Tensor& ComputationGraph::incremental_forward(VariableIndex last) { return ee->incremental_forward(last); }
 const Tensor& ComputationGraph::forward(VariableIndex last) { return ee->forward(last); }
+const Tensor& ComputationGraph::rerun(const expr::Expression& last) { return ee->rerun(last.i); }
+const Tensor& ComputationGraph::rerun(VariableIndex last) { return ee->rerun(last); }
 const Tensor& ComputationGraph::get_value(VariableIndex i) { return ee->get_value(i); }
 const Tensor& ComputationGraph::get_value(const expr::Expression& e) { return this->get_value(e.i); }
 const Tensor& ComputationGraph::get_gradient(VariableIndex i) { return ee->get_gradient(i); }
@@ -373,6 +430,24 @@ void ComputationGraph::set_check_validity(bool cv) {
   check_validity = cv;
 }
 
+void ComputationGraph::set_inference_mode(bool im) {
+  if (im != inference_mode)
+    ee->invalidate();
+  inference_mode = im;
+}
+
+void ComputationGraph::set_recompute(bool r) {
+  if (r != recompute)
+    ee->invalidate();
+  recompute = r;
+}
+
+void ComputationGraph::mark_recompute_segment() {
+  set_recompute(true);
+  if (segment_starts.empty() || (size_t)segment_starts.back() != nodes.size())
+    segment_starts.push_back((VariableIndex)nodes.size());
+}
+
 void ComputationGraph::print_graphviz() const {
   cerr << "digraph G {\n  rankdir=LR;\n  nodesep=.05;\n";
   unsigned nc = 0;
@@ -11,6 +11,7 @@
 #include <iostream>
 #include <initializer_list>
 #include <utility>
+#include <new>
 
 #include <boost/serialization/strong_typedef.hpp>
 
@@ -20,6 +21,8 @@
 #include "dynet/model.h"
 #include "dynet/devices.h"
 #include "dynet/sig.h"
+#include "dynet/small-vector.h"
+#include "dynet/node-arena.h"
 
 
 namespace dynet {
@@ -30,14 +33,16 @@ extern float* kSCALAR_ZERO;
 
 /**
  * \ingroup compgraph
- * \brief Gets the number of active graphs
- * \details This is 0 or 1, you can't create more than one graph at once
+ * \brief Gets the number of active graphs in the calling thread
+ * \details This is 0 or 1, a thread can't create more than one graph at
+ *          once. Graphs in different threads each have their own forward
+ *          and backward memory, and share the parameters.
  * \return Number of active graphs
  */
 int get_number_of_active_graphs();
 /**
  * \ingroup compgraph
- * \brief Get id of the current active graph
+ * \brief Get id of the current active graph in the calling thread
  * \details This can help check whether a graph is stale 
  * \return Id of the current graph
  */
@@ -318,6 +323,11 @@ struct ComputationGraph {
   /**
    * \brief Run forward pass from the last computed node to given one.
    * \details Useful if you want to add nodes and evaluate just the new parts.
+   *          Without autobatching, only the new nodes that `last` depends on
+   *          are computed, and the others when their value is requested.
+   *          Those read the parameters and the inputs bound to pointers as
+   *          they are when they are computed, for instance after an update
+   *          of the parameters, not as they were at this call.
    *
    * \param last Expression up to which the forward pass must be computed
    * \return Value of the `last` Expression after execution
@@ -326,14 +336,46 @@ struct ComputationGraph {
   /**
    * \brief Run forward pass from the last computed node to given one.
    * \details Useful if you want to add nodes and evaluate just the new parts.
+   *          Without autobatching, only the new nodes that `last` depends on
+   *          are computed, and the others when their value is requested.
+   *          Those read the parameters and the inputs bound to pointers as
+   *          they are when they are computed, for instance after an update
+   *          of the parameters, not as they were at this call.
    *
    * \param last Variable index of the node up to which the forward pass must be computed
    * \return Value of the end Node after execution
    */
   const Tensor& incremental_forward(VariableIndex i);
+  /**
+   * \brief Execute the graph again with the current data of its inputs
+   * \details For graphs of a fixed structure that are evaluated for many
+   *          examples: build the graph once with inputs and lookups that read
+   *          their data through pointers (e.g. `input(cg, d, &values)` or
+   *          `lookup(cg, p, &index)`), evaluate it once with forward(), then
+   *          update the data and call rerun(). The nodes that `last` depends
+   *          on are executed again in the memory, and with the batches, of the
+   *          previous evaluation, so the graph is not built, its dimensions
+   *          are not inferred and no memory is allocated. The inputs must keep
+   *          their dimensions.
+   *          Memory recycled in inference mode or discarded for recomputation
+   *          cannot be reused, in which case this is the same as forward().
+   *
+   * \param last Expression up to which the forward pass must be computed
+   * \return Value of the `last` Expression after execution
+   */
+  const Tensor& rerun(const expr::Expression& last);
+  /**
+   * \brief Execute the graph again with the current data of its inputs, see rerun(const expr::Expression&)
+   *
+   * \param i Variable index of the node up to which the forward pass must be computed
+   * \return Value of the end Node after execution
+   */
+  const Tensor& rerun(VariableIndex i);
   /**
    * \brief Get forward value for node at index i.
    * \details Performs forward evaluation if note available (may compute more than strictly what is needed).
+   *          A node that the earlier forward passes did not need is computed
+   *          now, from the current parameters and inputs.
    *
    * \param i Index of the variable from which you want the value
    * \return Requested value
@@ -342,6 +384,8 @@ struct ComputationGraph {
   /**
    * \brief Get forward value for the given expression
    * \details Performs forward evaluation if note available (may compute more than strictly what is needed).
+   *          A node that the earlier forward passes did not need is computed
+   *          now, from the current parameters and inputs.
    *
    * \param e Expression from which you want the value
    * \return Requested value
@@ -408,12 +452,76 @@ struct ComputationGraph {
   void set_immediate_compute(bool ic);
   // set check_validity variable
   void set_check_validity(bool cv);
+  /**
+   * \brief Turn inference mode on or off
+   * \details In inference mode, the memory of an intermediate value is
+   *          recycled as soon as all nodes that use it have been computed, so
+   *          peak memory grows with the width of the graph rather than with
+   *          its size. After a forward pass, only the value of the node that
+   *          was requested and of nodes that are not used by any other node
+   *          remain available, and backward() cannot be called. Dropout
+   *          and noise nodes act as the identity, and nodes do not allocate
+   *          auxiliary memory needed only for backward. Graphs start in
+   *          inference mode when dynet is initialized with --dynet-inference.
+   *
+   * \param im Whether to use inference mode
+   */
+  void set_inference_mode(bool im);
+  bool is_inference_mode() const { return inference_mode; }
+  /**
+   * \brief Turn recomputation of intermediate values on or off
+   * \details The nodes are split into segments, at the nodes marked with
+   *          mark_recompute_segment() if there are any, and otherwise into
+   *          segments of about sqrt(N) nodes for a graph of N nodes. The
+   *          forward pass only keeps the values that are used by later
+   *          segments, and the other values are recomputed one segment at a
+   *          time during backward(), so memory grows with the length of a
+   *          segment rather than with the size of the graph, at the cost of
+   *          about one more forward pass. Values of inputs, parameters and
+   *          stochastic nodes are always kept. This has no effect when
+   *          autobatching.
+   *
+   * \param r Whether to recompute values
+   */
+  void set_recompute(bool r);
+  bool is_recompute() const { return recompute; }
+  /**
+   * \brief Start a new recomputation segment at the next node
+   * \details Also turns on recomputation, see set_recompute().
+   */
+  void mark_recompute_segment();
 
   /**
    * \brief Used for debugging
    */
   void print_graphviz() const;
 
+  /**
+   * \brief Hands the graph over to another thread
+   * \details After this, the calling thread can create a new graph, and
+   *          the expressions of this graph can only be used again in the
+   *          thread that calls attach_to_thread(). See GraphPipeline.
+   */
+  void detach_from_thread();
+  /**
+   * \brief Takes over a graph detached by another thread
+   * \details The graph is then executed with the forward and backward
+   *          memory of the calling thread, which must not have a graph.
+   */
+  void attach_to_thread();
+
+  /**
+   * \brief Creates a node of type T in the memory of the graph
+   * \details The nodes of a graph are allocated together and released at
+   *          once by clear(), so nodes added to `nodes` must be created here.
+   *          A node that is replaced must be destroyed with delete_node().
+   */
+  template <class T, typename... Args>
+  T* new_node(Args&&... args) {
+    return new (arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+  void delete_node(Node* node);
+
   /**
    * \brief Get the unique graph ID
    * \details This ID is incremented by 1 each time a computation graph is created
@@ -424,16 +532,26 @@ struct ComputationGraph {
   // data
   std::vector<Node*> nodes;       // **stored in topological order**
   std::vector<VariableIndex> parameter_nodes; // nodes that contain parameters that can be updated (subset of nodes)
+  std::vector<VariableIndex> segment_starts; // first nodes of the marked recomputation segments
 
   ExecutionEngine* ee;  // handles the execution
 private:
   unsigned graph_id;
+  // whether the graph belongs to a thread, see detach_from_thread()
+  bool attached;
   // flag of whether to compute immediately for each expression, i.e., an imperative execution style to help debug.
   bool immediate_compute;
   // flag of checking Inf/NaN of each layer. Only performing checking when immediate_compute is also set to true.
   bool check_validity;
+  // flag of whether memory of dead values is recycled (no backward pass possible)
+  bool inference_mode;
+  // flag of whether forward values are recomputed during backward
+  bool recompute;
   void set_dim_for_new_node(const VariableIndex& i);
 
+  // memory of the nodes
+  NodeArena arena;
+
   std::vector<CGCheckpoint> checkpoints;
   CGCheckpoint _get_checkpoint();
   void _revert(CGCheckpoint checkpoint);
@@ -540,6 +658,52 @@ struct Node {
    */
   virtual bool supports_multibatch() const { return false; }
 
+  /**
+   * \brief Whether this node draws from the global random number generator
+   * \details Such nodes are always evaluated in graph order, even when other
+   *          nodes are executed in parallel.
+   * \return Whether the node is stochastic
+   */
+  virtual bool is_stochastic() const { return false; }
+
+  /**
+   * \brief Whether the node has a value
+   * \details Nodes removed by graph_optimize() keep their place in the
+   *          graph, but their value is never computed and takes no memory.
+   * \return Whether the node has a value
+   */
+  virtual bool has_value() const { return true; }
+
+  /**
+   * \brief Whether this node computes the same value as another node
+   * \details Used by graph_optimize() to merge identical nodes. It is only
+   *          called for nodes of the same type with the same arguments and
+   *          dimensions, and must compare all the side information of the
+   *          node (constants, indices, parameters). Nodes that read data which
+   *          may change between executions, such as inputs or nodes bound
+   *          to pointers, keep the default, which never merges.
+   *
+   * \param other Node of the same type as this one
+   * \return Whether the two nodes can be merged
+   */
+  virtual bool cse_equal(const Node& other) const { return false; }
+
+  /**
+   * \brief Whether the graph of this node is in inference mode
+   * \details No backward pass follows forward in inference mode, so nodes
+   *          can skip the work and auxiliary memory needed only for it.
+   *          Nodes such as dropout also behave as they do at test time.
+   * \return Whether the node is evaluated for inference only
+   */
+  bool for_inference() const;
+
+  /**
+   * \brief The name of the class of the node, without namespace
+   * \details Used to identify the type of nodes in profiles and recorded graphs
+   * \return The name of the class, for instance "Tanh"
+   */
+  std::string type_name() const;
+
   // perform the forward/backward passes in one or multiple calls
   /**
    * \brief perform the forward/backward passes in one or multiple calls
@@ -629,7 +793,7 @@ struct Node {
     else return NULL;
   }
 
-  std::vector<VariableIndex> args;/**< Dependency structure */
+  SmallVector<VariableIndex, 6> args;/**< Dependency structure, stored inline for nodes with few arguments */
 
   // memory size
   Dim dim; /**< Will be .size() = 0 initially filled in by forward() -- TODO fix this */
@@ -637,10 +801,10 @@ struct Node {
   Device* device; /**< pointer to the node, or null to inherit device from first input, or default when there is no input */
 
 protected:
-  Node() : args(), device(default_device) {}
-  explicit Node(const std::initializer_list<VariableIndex>& a) : args(a), device(default_device) {}
+  Node() : args(), device(default_device), cg_(nullptr) {}
+  explicit Node(const std::initializer_list<VariableIndex>& a) : args(a), device(default_device), cg_(nullptr) {}
   template <typename T>
-  explicit Node(const T&c) : args(c.begin(), c.end()), device(default_device) {}
+  explicit Node(const T&c) : args(c.begin(), c.end()), device(default_device), cg_(nullptr) {}
 
 private:
   ComputationGraph* cg_;  // pointer to the computation graph
@@ -653,7 +817,7 @@ public:
 template <class Function>
 inline VariableIndex ComputationGraph::add_function(const std::initializer_list<VariableIndex>& arguments) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new Function(arguments));
+  nodes.push_back(new_node<Function>(arguments));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
@@ -663,7 +827,7 @@ template <class Function, typename... Args>
 inline VariableIndex ComputationGraph::add_function(const std::initializer_list<VariableIndex>& arguments,
     Args&&... side_information) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new Function(arguments, std::forward<Args>(side_information)...));
+  nodes.push_back(new_node<Function>(arguments, std::forward<Args>(side_information)...));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
@@ -671,7 +835,7 @@ inline VariableIndex ComputationGraph::add_function(const std::initializer_list<
 template <class Function, typename T>
 inline VariableIndex ComputationGraph::add_function(const T& arguments) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new Function(arguments));
+  nodes.push_back(new_node<Function>(arguments));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
@@ -681,7 +845,7 @@ template <class Function, typename T, typename... Args>
 inline VariableIndex ComputationGraph::add_function(const T& arguments,
     Args&&... side_information) {
   VariableIndex new_node_index(nodes.size());
-  nodes.push_back(new Function(arguments, std::forward<Args>(side_information)...));
+  nodes.push_back(new_node<Function>(arguments, std::forward<Args>(side_information)...));
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
@@ -1,16 +1,27 @@
 #include "dynet/exec.h"
 
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <unordered_set>
 #include <unordered_map>
 #include <queue>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 #include "dynet/param-nodes.h"
 #include "dynet/globals.h"
 #include "dynet/timing.h"
+#include "dynet/thread-pool.h"
 
 #ifdef HAVE_CUDA
 #include "dynet/gpu-ops.h"
 #endif
 
+// maximum number of autobatching plans kept for reuse
+#define DYNET_MAX_BATCH_PLANS 64
+
 using namespace std;
 
 namespace dynet {
@@ -25,8 +36,57 @@ inline string print_vec(const std::vector<float> & vec) {
   return oss.str();
 }
 
+size_t MemoryPlan::place(Device* device, size_t n) {
+  Region& region = regions[device];
+  const size_t offset = region.size;
+  region.size += device->mem->round_up_align(n);
+  return offset;
+}
+
+void MemoryPlan::allocate(DeviceMempool mp) {
+  for (auto & kv : regions) {
+    if (kv.second.size == 0) continue;
+    kv.second.base = static_cast<char*>(kv.first->pool(mp)->allocate(kv.second.size));
+    if (kv.second.base == nullptr)
+      DYNET_RUNTIME_ERR("Ran out of memory when allocating " << kv.second.size << " planned bytes on " << kv.first->name);
+  }
+}
+
+void* MemoryPlan::address(Device* device, size_t offset) const {
+  auto it = regions.find(device);
+  DYNET_ASSERT(it != regions.end(), "Attempt to access memory that was not planned in MemoryPlan::address");
+  return it->second.base + offset;
+}
+
+size_t MemoryPlan::size(Device* device) const {
+  auto it = regions.find(device);
+  return it == regions.end() ? 0 : it->second.size;
+}
+
 ExecutionEngine::~ExecutionEngine() {}
 
+void* ExecutionEngine::allocate_fxs(Device* device, size_t n) {
+  AlignedMemoryPool* pool = device->pool(DeviceMempool::FXS);
+  if (!cg.is_inference_mode() && !cg.is_recompute())
+    return pool->allocate(n);
+  auto it = fxs_recyclers.find(device);
+  if (it == fxs_recyclers.end())
+    it = fxs_recyclers.insert(make_pair(device, RecyclingMemoryPool(pool))).first;
+  return it->second.allocate(n);
+}
+
+void ExecutionEngine::release_fxs(Device* device, void* p, size_t n) {
+  auto it = fxs_recyclers.find(device);
+  if (it != fxs_recyclers.end())
+    it->second.release(p, n);
+}
+
+void ExecutionEngine::free_fxs() {
+  for(Device* dev : dynet::devices)
+    dev->pool(DeviceMempool::FXS)->free();
+  fxs_recyclers.clear();
+}
+
 vector<const Tensor*> ExecutionEngine::forward(std::vector<VariableIndex> is) {
   invalidate();
   VariableIndex i=*(std::max_element(is.begin(),is.end()));
@@ -45,6 +105,7 @@ void SimpleExecutionEngine::invalidate() {
 
 void SimpleExecutionEngine::invalidate(unsigned i) {
   num_nodes_evaluated = i;
+  fxs_recyclers.clear();
 }
 
 const Tensor& SimpleExecutionEngine::forward() {
@@ -59,9 +120,15 @@ const Tensor& SimpleExecutionEngine::forward(VariableIndex i) {
 
 const Tensor& SimpleExecutionEngine::get_value(VariableIndex i) {
   DYNET_ASSERT(i < cg.nodes.size(), "Out-of-bounds variable access in SimpleExecutionEngine::get_value()");
+  if (!cg.nodes[i]->has_value())
+    DYNET_RUNTIME_ERR("Requested value of node " << i << ", which was removed by graph_optimize()");
   if (i >= num_nodes_evaluated) {
     incremental_forward();
   }
+  if (nfxs[i].v == nullptr || pending[i]) {
+    vector<VariableIndex> recomputed;
+    ensure_value(i, recomputed);
+  }
   return nfxs[i];
 }
 
@@ -70,6 +137,12 @@ const Tensor& SimpleExecutionEngine::get_gradient(VariableIndex i) {
   if (i >= backward_computed) {
     DYNET_RUNTIME_ERR("Requested gradient for node " << i << ", but backward pass was computed from node " << (backward_computed - 1));
   }
+  // nodes that the backward pass did not reach have a zero gradient, which
+  // only gets memory when it is requested
+  if (ndEdfs[i].v == nullptr) {
+    ndEdfs[i].v = static_cast<float*>(ndEdfs[i].device->pool(DeviceMempool::DEDFS)->allocate(ndEdfs[i].d.size() * sizeof(float)));
+    TensorTools::zero(ndEdfs[i]);
+  }
   return ndEdfs[i];
 }
 
@@ -83,94 +156,319 @@ const Tensor& SimpleExecutionEngine::incremental_forward(VariableIndex i) {
 
   // free any old memory if this is a new CG
   if (num_nodes_evaluated == 0)
-    for(Device* dev : dynet::devices)
-      dev->pools[(int)DeviceMempool::FXS]->free();
+    free_fxs();
 
   if (i >= num_nodes_evaluated) {
     string current_node_name;
     nfxs.resize(i + 1);
 
+    // only the nodes that i depends on are computed now, the others are
+    // computed when their value is requested
+    const VariableIndex first = num_nodes_evaluated;
+    const vector<bool> needed = ancestors(first, i);
+    pending.resize(i + 1);
+
+    // in inference mode, count how many of the new nodes computed now use
+    // each new value, so that its memory can be recycled after the last of
+    // them. Pending nodes recompute the values they need that were recycled.
+    const bool recycle = cg.is_inference_mode();
+    vector<unsigned> uses;
+    if (recycle) {
+      uses.resize(i + 1 - first, 0);
+      for (VariableIndex j = first; j <= i; ++j)
+        if (needed[j - first])
+          for (VariableIndex arg : cg.nodes[j]->args)
+            if (arg >= first) ++uses[arg - first];
+    }
+
+    // with recomputation, discard the values that are only used within
+    // their segment once the segment has been computed
+    const bool discard = !recycle && cg.is_recompute();
+    vector<VariableIndex> last_use, segments, recomputed;
+    VariableIndex segment_begin = first;
+    if (discard) {
+      last_use.resize(i + 1 - first, (VariableIndex)0);
+      for (VariableIndex j = first; j <= i; ++j)
+        for (VariableIndex arg : cg.nodes[j]->args)
+          if (arg >= first) last_use[arg - first] = j;
+      segments = recompute_segments(i + 1);
+    }
+
+    // unless memory is recycled, the memory of all new nodes is laid out
+    // and allocated at once, in the layout of a full forward pass
+    const bool planned = !recycle && !discard;
+    if (planned)
+      plan_fxs(first, i);
+
     //vector<string> dummy(5, "x");
     vector<const Tensor*> xs(16);
     for (; num_nodes_evaluated <= i; ++num_nodes_evaluated) {
       const Node* node = cg.nodes[num_nodes_evaluated];
-      if (autobatch_debug_flag) { 
-        current_node_name = node->as_dummy_string();
-        timer.start(current_node_name);
-      }
-      xs.resize(node->arity());
-      unsigned ai = 0;
-      for (VariableIndex arg : node->args) {
-        xs[ai] = &nfxs[arg];
-        ++ai;
+      pending[num_nodes_evaluated] = !needed[num_nodes_evaluated - first];
+      if (pending[num_nodes_evaluated]) {
+        if (!planned)
+          nfxs[num_nodes_evaluated].v = nullptr;
+      } else {
+        if (autobatch_debug_flag) { 
+          current_node_name = node->as_dummy_string();
+          timer.start(current_node_name);
+        }
+        xs.resize(node->arity());
+        unsigned ai = 0;
+        for (VariableIndex arg : node->args) {
+          if (nfxs[arg].v == nullptr || pending[arg])
+            ensure_value(arg, recomputed);
+          xs[ai] = &nfxs[arg];
+          ++ai;
+        }
+        if (!planned)
+          allocate_fx(num_nodes_evaluated);
+
+        node->forward(xs, nfxs[num_nodes_evaluated]);
+
+        if (recycle) {
+          if (node->aux_mem != nullptr)
+            release_fxs(node->device, node->aux_mem, node->aux_storage_size());
+          for (VariableIndex arg : node->args) {
+            if (arg >= first && --uses[arg - first] == 0) {
+              Tensor& dead = nfxs[arg];
+              release_fxs(dead.device, dead.v, dead.d.size() * sizeof(float));
+              dead.v = nullptr;
+            }
+          }
+        }
+
+        if (autobatch_debug_flag) { timer.stop(current_node_name); }
       }
-      nfxs[num_nodes_evaluated].d = node->dim;
-      // Get the device
-      DYNET_ASSERT(node->device != nullptr, "Attempt to access null device in SimpleExecutionEngine::incremental_forward");
-      nfxs[num_nodes_evaluated].device = node->device;
-      nfxs[num_nodes_evaluated].mem_pool = DeviceMempool::FXS;
-      // Get the memory
-      nfxs[num_nodes_evaluated].v = static_cast<float*>(nfxs[num_nodes_evaluated].device->pools[(int)DeviceMempool::FXS]->allocate(node->dim.size() * sizeof(float)));
-      if (nfxs[num_nodes_evaluated].v == nullptr)
-        DYNET_RUNTIME_ERR("Ran out of memory when executing node " << num_nodes_evaluated);
-      void* aux_mem = nullptr;
-      size_t aux_size = node->aux_storage_size();
-      if (aux_size) {
-        aux_mem = nfxs[num_nodes_evaluated].device->pools[(int)DeviceMempool::FXS]->allocate(aux_size);
-        if (!aux_mem)
-          DYNET_RUNTIME_ERR("Ran out of auxiliary memory when executing node " << num_nodes_evaluated);
+
+      if (discard) {
+        const VariableIndex next = (VariableIndex)(num_nodes_evaluated + 1);
+        if (next > i || binary_search(segments.begin(), segments.end(), next)) {
+          for (VariableIndex j = segment_begin; j < num_nodes_evaluated; ++j) {
+            const Node* n = cg.nodes[j];
+            if (n->arity() > 0 && !n->is_stochastic() && last_use[j - first] != (VariableIndex)0 && last_use[j - first] <= num_nodes_evaluated && nfxs[j].v != nullptr)
+              discard_value(j);
+          }
+          segment_begin = next;
+        }
       }
-      node->aux_mem = aux_mem;
+    }
+  }
+
+  return nfxs[i];
+}
+
+// finds the nodes that i depends on, which are executed again by rerun().
+// The other values become stale, and are computed again when requested.
+// Returns false if some of the needed values have no memory to reuse.
+bool SimpleExecutionEngine::prepare_rerun(VariableIndex i, vector<bool>& needed) {
+  // memory that was recycled or discarded cannot be reused
+  if (i >= num_nodes_evaluated || cg.is_inference_mode() || cg.is_recompute())
+    return false;
+  needed = ancestors((VariableIndex)0, i);
+  for (VariableIndex j = (VariableIndex)0; j <= i; ++j)
+    if (needed[j] && nfxs[j].v == nullptr)
+      return false;
+  for (VariableIndex j = (VariableIndex)0; j < num_nodes_evaluated; ++j)
+    pending[j] = (j > i || !needed[j]);
+  backward_computed = 0;
+  return true;
+}
 
-      node->forward(xs, nfxs[num_nodes_evaluated]);
+const Tensor& SimpleExecutionEngine::rerun(VariableIndex i) {
+  DYNET_ASSERT(i < cg.nodes.size(), "Out-of-bounds variable access in SimpleExecutionEngine::rerun()");
+  vector<bool> needed;
+  if (!prepare_rerun(i, needed))
+    return forward(i);
+  vector<const Tensor*> xs;
+  for (VariableIndex j = (VariableIndex)0; j <= i; ++j) {
+    if (!needed[j]) continue;
+    const Node* node = cg.nodes[j];
+    xs.resize(node->arity());
+    unsigned ai = 0;
+    for (VariableIndex arg : node->args)
+      xs[ai++] = &nfxs[arg];
+    node->forward(xs, nfxs[j]);
+  }
+  return nfxs[i];
+}
+
+// allocates the output (and auxiliary) memory of node i from the FXS pool
+void SimpleExecutionEngine::allocate_fx(VariableIndex i) {
+  const Node* node = cg.nodes[i];
+  Tensor& fx = nfxs[i];
+  fx.d = node->dim;
+  // Get the device
+  DYNET_ASSERT(node->device != nullptr, "Attempt to access null device in SimpleExecutionEngine::incremental_forward");
+  fx.device = node->device;
+  fx.mem_pool = DeviceMempool::FXS;
+  // Get the memory
+  fx.v = static_cast<float*>(allocate_fxs(fx.device, node->dim.size() * sizeof(float)));
+  if (fx.v == nullptr)
+    DYNET_RUNTIME_ERR("Ran out of memory when executing node " << i);
+  void* aux_mem = nullptr;
+  size_t aux_size = node->aux_storage_size();
+  if (aux_size) {
+    aux_mem = allocate_fxs(fx.device, aux_size);
+    if (!aux_mem)
+      DYNET_RUNTIME_ERR("Ran out of auxiliary memory when executing node " << i);
+  }
+  node->aux_mem = aux_mem;
+}
 
-      if (autobatch_debug_flag) { timer.stop(current_node_name); }
+// lays out the output and auxiliary memory of nodes [first, last] and
+// allocates it from the FXS pool with one request per device
+void SimpleExecutionEngine::plan_fxs(VariableIndex first, VariableIndex last) {
+  MemoryPlan plan;
+  vector<size_t> fx_offsets(last + 1 - first), aux_offsets(last + 1 - first);
+  for (VariableIndex j = first; j <= last; ++j) {
+    const Node* node = cg.nodes[j];
+    DYNET_ASSERT(node->device != nullptr, "Attempt to access null device in SimpleExecutionEngine::plan_fxs");
+    if (!node->has_value()) continue;
+    fx_offsets[j - first] = plan.place(node->device, node->dim.size() * sizeof(float));
+    const size_t aux_size = node->aux_storage_size();
+    if (aux_size)
+      aux_offsets[j - first] = plan.place(node->device, aux_size);
+  }
+  plan.allocate(DeviceMempool::FXS);
+  for (VariableIndex j = first; j <= last; ++j) {
+    const Node* node = cg.nodes[j];
+    Tensor& fx = nfxs[j];
+    fx.d = node->dim;
+    fx.device = node->device;
+    fx.mem_pool = DeviceMempool::FXS;
+    if (!node->has_value()) {
+      fx.v = nullptr;
+      continue;
     }
+    fx.v = static_cast<float*>(plan.address(node->device, fx_offsets[j - first]));
+    node->aux_mem = node->aux_storage_size() ? plan.address(node->device, aux_offsets[j - first]) : nullptr;
   }
+}
 
-  return nfxs[i];
+// returns the first nodes of the recomputation segments of nodes [0, num_nodes)
+vector<VariableIndex> SimpleExecutionEngine::recompute_segments(unsigned num_nodes) const {
+  vector<VariableIndex> segments(1, (VariableIndex)0);
+  if (cg.segment_starts.size() > 0) {
+    for (VariableIndex s : cg.segment_starts)
+      if (s > segments.back() && s < num_nodes)
+        segments.push_back(s);
+  } else {
+    const unsigned len = max(1u, (unsigned)ceil(sqrt((double)num_nodes)));
+    for (unsigned s = len; s < num_nodes; s += len)
+      segments.push_back((VariableIndex)s);
+  }
+  return segments;
 }
 
-void SimpleExecutionEngine::backward(bool full) {
-  DYNET_ASSERT(nfxs.size() >= cg.nodes.size(), "Mismatched array sizes in SimpleExecutionEngine::backward");
-  backward((VariableIndex)(cg.nodes.size()-1),full);
+// marks the nodes in [first, i] that the value of node i depends on
+vector<bool> SimpleExecutionEngine::ancestors(VariableIndex first, VariableIndex i) const {
+  vector<bool> needed(i + 1 - first, false);
+  needed[i - first] = true;
+  for (unsigned j = i + 1; j-- > first; )
+    if (needed[j - first])
+      for (VariableIndex arg : cg.nodes[j]->args)
+        if (arg >= first) needed[arg - first] = true;
+  return needed;
 }
 
-// TODO what is happening with parameter nodes if from_where > param_node_id ?
-void SimpleExecutionEngine::backward(VariableIndex from_where, bool full) {
-  if(!(from_where < nfxs.size()))
-    incremental_forward(from_where);
-  if (nfxs[from_where].d.size() != 1)
-    DYNET_INVALID_ARG("backward() can only be called on scalar nodes, but node " << from_where << " has dimension: " << nfxs[from_where].d);
+// computes the value of node i if it was skipped by the forward pass or
+// discarded for recomputation, along with the values it depends on. The
+// nodes whose memory had to be allocated again are added to recomputed.
+void SimpleExecutionEngine::ensure_value(VariableIndex i, vector<VariableIndex>& recomputed) {
+  vector<VariableIndex> todo(1, i), needed;
+  unordered_set<unsigned> seen;
+  while (!todo.empty()) {
+    const VariableIndex j = todo.back();
+    todo.pop_back();
+    if (!seen.insert(j).second) continue;
+    if (!pending[j]) {
+      if (nfxs[j].v != nullptr) continue;
+      // values recycled in inference mode or discarded for recomputation
+      // are computed again, unless they were drawn at random
+      if (!cg.is_inference_mode() && !cg.is_recompute())
+        DYNET_RUNTIME_ERR("Requested value of node " << j << ", which has no memory");
+      if (cg.nodes[j]->is_stochastic())
+        DYNET_RUNTIME_ERR("Requested value of node " << j << ", but its memory was recycled in inference mode");
+    }
+    needed.push_back(j);
+    for (VariableIndex arg : cg.nodes[j]->args)
+      todo.push_back(arg);
+  }
+  sort(needed.begin(), needed.end());
+  vector<const Tensor*> xs;
+  for (VariableIndex j : needed) {
+    const Node* node = cg.nodes[j];
+    xs.resize(node->arity());
+    unsigned ai = 0;
+    for (VariableIndex arg : node->args)
+      xs[ai++] = &nfxs[arg];
+    if (nfxs[j].v == nullptr) {
+      allocate_fx(j);
+      recomputed.push_back(j);
+    }
+    node->forward(xs, nfxs[j]);
+    pending[j] = false;
+  }
+}
 
-  const unsigned num_nodes = from_where+1;
+// returns the memory of the value of node i, which can be recomputed later
+void SimpleExecutionEngine::discard_value(VariableIndex i) {
+  const Node* node = cg.nodes[i];
+  Tensor& fx = nfxs[i];
+  if (node->aux_mem != nullptr) {
+    release_fxs(node->device, node->aux_mem, node->aux_storage_size());
+    node->aux_mem = nullptr;
+  }
+  release_fxs(fx.device, fx.v, fx.d.size() * sizeof(float));
+  fx.v = nullptr;
+}
+
+// allocates zeroed dE/df memory for nodes [0, num_nodes) and sets dE/dE = 1
+// Only the gradients of the nodes in needed get memory, and they are not
+// zeroed here: init_gradient() zeroes each one right before its first
+// contribution, while it is about to be used anyway.
+void SimpleExecutionEngine::allocate_gradients(unsigned num_nodes, const vector<bool>& needed) {
   ndEdfs.resize(num_nodes);
+  ndEdfs_initialized.assign(num_nodes, 0);
   for(Device* device : devices)
-    device->pools[(int)DeviceMempool::DEDFS]->free();
+    device->pool(DeviceMempool::DEDFS)->free();
+  MemoryPlan plan;
+  vector<size_t> offsets(num_nodes);
+  for (unsigned i = 0; i + 1 < num_nodes; ++i)
+    if (needed[i])
+      offsets[i] = plan.place(cg.nodes[i]->device, cg.nodes[i]->dim.size() * sizeof(float));
+  plan.allocate(DeviceMempool::DEDFS);
   for (unsigned i = 0; i < num_nodes; ++i) {
-    const auto dim = nfxs[i].d;
-    ndEdfs[i].d = dim;
-    ndEdfs[i].device = nfxs[i].device;
+    ndEdfs[i].d = cg.nodes[i]->dim;
+    ndEdfs[i].device = cg.nodes[i]->device;
     ndEdfs[i].mem_pool = DeviceMempool::DEDFS;
-    ndEdfs[i].v = static_cast<float*>(ndEdfs[i].device->pools[(int)DeviceMempool::DEDFS]->allocate(dim.size() * sizeof(float)));
-    if (!ndEdfs[i].v)
-      DYNET_RUNTIME_ERR("out of memory while attempting to allocate space for derivatives of node " << i);
+    ndEdfs[i].v = needed[i] ? static_cast<float*>(plan.address(ndEdfs[i].device, offsets[i])) : nullptr;
   }
-  for(Device* device : devices)
-    device->pools[(int)DeviceMempool::DEDFS]->zero_allocated_memory();
   // initialize dE/dE = 1
   ndEdfs.back().v = kSCALAR_ONE;
+  ndEdfs_initialized.back() = 1;
+}
 
-  // here we find constant paths to avoid doing extra work
-  // by default, a node is constant unless
-  //   1) it is a parameter node
-  //   2) it depends on a non-constant node
-  // (thus, functions of constants and inputs end up being
-  //  false in this computation)
+void SimpleExecutionEngine::init_gradient(VariableIndex i) {
+  if (!ndEdfs_initialized[i]) {
+    TensorTools::zero(ndEdfs[i]);
+    ndEdfs_initialized[i] = 1;
+  }
+}
+
+// here we find constant paths to avoid doing extra work
+// by default, a node is constant unless
+//   1) it is a parameter node
+//   2) it depends on a non-constant node
+// (thus, functions of constants and inputs end up being
+//  false in this computation)
+vector<bool> SimpleExecutionEngine::compute_needs_derivative(unsigned num_nodes, bool full) const {
   vector<bool> needs_derivative(num_nodes, full);
   if (!full) {
     for (auto i : cg.parameter_nodes)
-      needs_derivative[i] = true;
+      if (i < num_nodes)
+        needs_derivative[i] = true;
 
     for (unsigned ni = 0; ni < num_nodes; ++ni) {
       bool nd = needs_derivative[ni];
@@ -179,25 +477,74 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, bool full) {
       needs_derivative[ni] = nd;
     }
   }
+  return needs_derivative;
+}
 
-  // loop in reverse topological order
-  // consider only nodes that participate in the computation.
+// the nodes that the node num_nodes - 1 depends on
+vector<bool> SimpleExecutionEngine::compute_in_computation(unsigned num_nodes) const {
   vector<bool> in_computation(num_nodes, false);
   in_computation[num_nodes - 1] = true;
+  for (int i = num_nodes - 1; i >= 0; --i)
+    if (in_computation[i])
+      for (VariableIndex arg : cg.nodes[i]->args)
+        in_computation[arg] = true;
+  return in_computation;
+}
+
+void SimpleExecutionEngine::backward(bool full) {
+  DYNET_ASSERT(nfxs.size() >= cg.nodes.size(), "Mismatched array sizes in SimpleExecutionEngine::backward");
+  backward((VariableIndex)(cg.nodes.size()-1),full);
+}
+
+// TODO what is happening with parameter nodes if from_where > param_node_id ?
+void SimpleExecutionEngine::backward(VariableIndex from_where, bool full) {
+  if (cg.is_inference_mode())
+    DYNET_RUNTIME_ERR("backward() cannot be called on a ComputationGraph in inference mode");
+  if(!(from_where < nfxs.size()))
+    incremental_forward(from_where);
+  if (cg.nodes[from_where]->dim.size() != 1)
+    DYNET_INVALID_ARG("backward() can only be called on scalar nodes, but node " << from_where << " has dimension: " << cg.nodes[from_where]->dim);
+
+  const unsigned num_nodes = from_where+1;
+  vector<bool> needs_derivative = compute_needs_derivative(num_nodes, full);
+  // consider only nodes that participate in the computation.
+  const vector<bool> in_computation = compute_in_computation(num_nodes);
+  vector<bool> needed(num_nodes);
+  for (unsigned i = 0; i < num_nodes; ++i)
+    needed[i] = needs_derivative[i] && in_computation[i];
+  allocate_gradients(num_nodes, needed);
+
+  // loop in reverse topological order
   vector<const Tensor*> xs;
+  // values that were skipped or discarded are computed when needed, and
+  // with recomputation discarded again once their segment has been processed
+  const bool recompute = cg.is_recompute();
+  vector<VariableIndex> segments, recomputed;
+  if (recompute)
+    segments = recompute_segments(num_nodes);
   for (int i = num_nodes - 1; i >= 0; --i) {
+    if (recompute && recomputed.size() > 0 && binary_search(segments.begin(), segments.end(), (VariableIndex)(i + 1))) {
+      for (VariableIndex j : recomputed)
+        discard_value(j);
+      recomputed.clear();
+    }
     if (!in_computation[i]) continue;
     const Node* node = cg.nodes[i];
+    if (nfxs[i].v == nullptr || pending[i])
+      ensure_value((VariableIndex)i, recomputed);
+    for (VariableIndex arg : node->args)
+      if (nfxs[arg].v == nullptr || pending[arg])
+        ensure_value(arg, recomputed);
     xs.resize(node->arity());
     unsigned ai = 0;
     for (VariableIndex arg : node->args) {
-      in_computation[arg] = true;
       xs[ai] = &nfxs[arg];
       ++ai;
     }
     ai = 0;
     for (VariableIndex arg : node->args) {
       if (needs_derivative[arg]) {
+        init_gradient(arg);
         node->backward(xs, nfxs[i], ndEdfs[i], ai, ndEdfs[arg]);
       }
       ++ai;
@@ -208,17 +555,382 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, bool full) {
   // this is simpler than you might find in some other frameworks
   // since we assume parameters come into the graph as a "function"
   // that returns the current value of the parameters
+  // parameters that the node does not depend on get no gradient
+  for (VariableIndex i : cg.parameter_nodes)
+    if (i < num_nodes && needed[i])
+      static_cast<ParameterNodeBase*>(cg.nodes[i])->accumulate_grad(ndEdfs[i]);
+  backward_computed = from_where;
+
+  for (VariableIndex j : recomputed)
+    discard_value(j);
+}
+
+// there is one pool for each number of threads, shared by all graphs; pools
+// are never destroyed, since another engine may still be running on them
+static ThreadPool& exec_thread_pool(unsigned num_threads) {
+  static unordered_map<unsigned, unique_ptr<ThreadPool> > pools;
+  static mutex pool_mutex;
+  lock_guard<mutex> lk(pool_mutex);
+  unique_ptr<ThreadPool>& pool = pools[num_threads];
+  if (!pool)
+    pool.reset(new ThreadPool(num_threads));
+  return *pool;
+}
+
+const Tensor& ParallelExecutionEngine::incremental_forward(VariableIndex i) {
+  DYNET_ASSERT(i < cg.nodes.size(), "Out-of-bounds variable access in ParallelExecutionEngine::incremental_forward()");
+  // recomputation works one node at a time
+  if (cg.is_recompute())
+    return SimpleExecutionEngine::incremental_forward(i);
+
+  // free any old memory if this is a new CG
+  if (num_nodes_evaluated == 0)
+    free_fxs();
+
+  if (i >= num_nodes_evaluated) {
+    nfxs.resize(i + 1);
+
+    // Group the new nodes that i depends on into wavefronts: the nodes of
+    // wavefront l only depend on nodes that were computed before, or are in
+    // wavefronts < l. The other nodes are computed when requested.
+    const VariableIndex first = num_nodes_evaluated;
+    const vector<bool> needed = ancestors(first, i);
+    pending.resize(i + 1);
+    vector<unsigned> level(i + 1 - first, 0);
+    vector<vector<VariableIndex> > wavefronts;
+    vector<VariableIndex> recomputed;
+    // the memory is laid out in node order before any node is run, so the
+    // layout does not depend on the wavefronts. Otherwise pending nodes get
+    // memory when they are computed, as in the simple engine.
+    const bool planned = !cg.is_inference_mode();
+    for (VariableIndex j = first; j <= i; ++j) {
+      pending[j] = !needed[j - first];
+      if (pending[j]) {
+        if (!planned)
+          nfxs[j].v = nullptr;
+        continue;
+      }
+      for (VariableIndex arg : cg.nodes[j]->args)
+        if (arg < first && (nfxs[arg].v == nullptr || pending[arg]))
+          ensure_value(arg, recomputed);
+      unsigned l = 0;
+      for (VariableIndex arg : cg.nodes[j]->args)
+        if (arg >= first)
+          l = max(l, level[arg - first] + 1);
+      level[j - first] = l;
+      if (l >= wavefronts.size())
+        wavefronts.resize(l + 1);
+      wavefronts[l].push_back(j);
+    }
+
+    if (planned)
+      plan_fxs(first, i);
+
+    // in inference mode, count the uses of each new value as the simple
+    // engine does. A value is recycled once the wavefront holding its last
+    // consumer has completed, serially so the memory layout stays deterministic.
+    vector<unsigned> uses;
+    if (!planned) {
+      uses.resize(i + 1 - first, 0);
+      for (auto & wavefront : wavefronts)
+        for (VariableIndex j : wavefront)
+          for (VariableIndex arg : cg.nodes[j]->args)
+            if (arg >= first) ++uses[arg - first];
+    }
+
+    ThreadPool & pool = exec_thread_pool(num_threads);
+    vector<function<void()> > tasks;
+    for (auto & wavefront : wavefronts) {
+      tasks.clear();
+      for (VariableIndex j : wavefront) {
+        // allocation is done serially so the memory layout is deterministic
+        if (!planned)
+          allocate_fx(j);
+        auto task = [this, j] {
+          const Node* node = cg.nodes[j];
+          vector<const Tensor*> xs(node->arity());
+          unsigned ai = 0;
+          for (VariableIndex arg : node->args)
+            xs[ai++] = &nfxs[arg];
+          node->forward(xs, nfxs[j]);
+        };
+        // nodes drawing from the global random engine run in order on this thread
+        if (cg.nodes[j]->is_stochastic())
+          task();
+        else
+          tasks.push_back(task);
+      }
+      pool.run(tasks);
+      if (!planned) {
+        for (VariableIndex j : wavefront) {
+          const Node* node = cg.nodes[j];
+          if (node->aux_mem != nullptr)
+            release_fxs(node->device, node->aux_mem, node->aux_storage_size());
+          for (VariableIndex arg : node->args) {
+            if (arg >= first && --uses[arg - first] == 0) {
+              Tensor& dead = nfxs[arg];
+              release_fxs(dead.device, dead.v, dead.d.size() * sizeof(float));
+              dead.v = nullptr;
+            }
+          }
+        }
+      }
+    }
+    num_nodes_evaluated = i + 1;
+  }
+
+  return nfxs[i];
+}
+
+const Tensor& ParallelExecutionEngine::rerun(VariableIndex i) {
+  DYNET_ASSERT(i < cg.nodes.size(), "Out-of-bounds variable access in ParallelExecutionEngine::rerun()");
+  vector<bool> needed;
+  if (!prepare_rerun(i, needed))
+    return forward(i);
+  vector<unsigned> level(i + 1, 0);
+  vector<vector<VariableIndex> > wavefronts;
+  for (VariableIndex j = (VariableIndex)0; j <= i; ++j) {
+    if (!needed[j]) continue;
+    unsigned l = 0;
+    for (VariableIndex arg : cg.nodes[j]->args)
+      l = max(l, level[arg] + 1);
+    level[j] = l;
+    if (l >= wavefronts.size())
+      wavefronts.resize(l + 1);
+    wavefronts[l].push_back(j);
+  }
+  ThreadPool & pool = exec_thread_pool(num_threads);
+  vector<function<void()> > tasks;
+  for (auto & wavefront : wavefronts) {
+    tasks.clear();
+    for (VariableIndex j : wavefront) {
+      auto task = [this, j] {
+        const Node* node = cg.nodes[j];
+        vector<const Tensor*> xs(node->arity());
+        unsigned ai = 0;
+        for (VariableIndex arg : node->args)
+          xs[ai++] = &nfxs[arg];
+        node->forward(xs, nfxs[j]);
+      };
+      if (cg.nodes[j]->is_stochastic())
+        task();
+      else
+        tasks.push_back(task);
+    }
+    pool.run(tasks);
+  }
+  return nfxs[i];
+}
+
+void ParallelExecutionEngine::backward(VariableIndex from_where, bool full) {
+  if (cg.is_recompute()) {
+    SimpleExecutionEngine::backward(from_where, full);
+    return;
+  }
+  if (cg.is_inference_mode())
+    DYNET_RUNTIME_ERR("backward() cannot be called on a ComputationGraph in inference mode");
+  if(!(from_where < nfxs.size()))
+    incremental_forward(from_where);
+  if (nfxs[from_where].d.size() != 1)
+    DYNET_INVALID_ARG("backward() can only be called on scalar nodes, but node " << from_where << " has dimension: " << nfxs[from_where].d);
+
+  const unsigned num_nodes = from_where+1;
+  vector<bool> needs_derivative = compute_needs_derivative(num_nodes, full);
+
+  // find the nodes that participate in the computation, and their wavefront
+  const vector<bool> in_computation = compute_in_computation(num_nodes);
+  vector<bool> needed(num_nodes);
+  for (unsigned i = 0; i < num_nodes; ++i)
+    needed[i] = needs_derivative[i] && in_computation[i];
+  allocate_gradients(num_nodes, needed);
+  vector<unsigned> level(num_nodes, 0);
+  vector<vector<VariableIndex> > wavefronts;
+  vector<VariableIndex> recomputed;
+  for (unsigned i = 0; i < num_nodes; ++i) {
+    if (!in_computation[i]) continue;
+    if (pending[i])
+      ensure_value((VariableIndex)i, recomputed);
+    unsigned l = 0;
+    for (VariableIndex arg : cg.nodes[i]->args)
+      l = max(l, level[arg] + 1);
+    level[i] = l;
+    if (l >= wavefronts.size())
+      wavefronts.resize(l + 1);
+    wavefronts[l].push_back((VariableIndex)i);
+  }
+
+  // Every consumer of a node is in a later wavefront, so going through the
+  // wavefronts in reverse, dE/df of each node is complete before it is
+  // propagated. Within a wavefront, all contributions to the same argument
+  // are made by the same task in decreasing node order, which keeps the
+  // accumulation race-free and deterministic. Nodes with auxiliary memory may
+  // use it as scratch space in backward, so all of their arguments are
+  // handled by a single task.
+  ThreadPool & pool = exec_thread_pool(num_threads);
+  vector<function<void()> > tasks;
+  unordered_map<unsigned, unsigned> parent;
+  function<unsigned(unsigned)> find = [&](unsigned x) {
+    auto it = parent.find(x);
+    if (it == parent.end() || it->second == x) return x;
+    return it->second = find(it->second);
+  };
+  for (int l = (int)wavefronts.size() - 1; l >= 0; --l) {
+    auto & wavefront = wavefronts[l];
+    parent.clear();
+    for (auto it = wavefront.rbegin(); it != wavefront.rend(); ++it) {
+      const Node* node = cg.nodes[*it];
+      if (node->aux_storage_size() == 0) continue;
+      int first = -1;
+      for (VariableIndex arg : node->args) {
+        if (!needs_derivative[arg]) continue;
+        if (first < 0) first = find(arg);
+        else parent[find(arg)] = first;
+      }
+    }
+    unordered_map<unsigned, unsigned> group_ids;
+    vector<vector<pair<VariableIndex, unsigned> > > groups;
+    for (auto it = wavefront.rbegin(); it != wavefront.rend(); ++it) {
+      unsigned ai = 0;
+      for (VariableIndex arg : cg.nodes[*it]->args) {
+        if (needs_derivative[arg]) {
+          auto gid = group_ids.insert(make_pair(find(arg), groups.size()));
+          if (gid.second) groups.resize(groups.size() + 1);
+          groups[gid.first->second].push_back(make_pair(*it, ai));
+        }
+        ++ai;
+      }
+    }
+    tasks.clear();
+    for (auto & group : groups) {
+      tasks.push_back([this, &group] {
+        vector<const Tensor*> xs;
+        for (auto & contrib : group) {
+          const Node* node = cg.nodes[contrib.first];
+          xs.resize(node->arity());
+          unsigned ai = 0;
+          for (VariableIndex arg : node->args)
+            xs[ai++] = &nfxs[arg];
+          init_gradient(node->args[contrib.second]);
+          node->backward(xs, nfxs[contrib.first], ndEdfs[contrib.first], contrib.second, ndEdfs[node->args[contrib.second]]);
+        }
+      });
+    }
+    pool.run(tasks);
+  }
+
+  // accumulate gradients into parameters
   for (VariableIndex i : cg.parameter_nodes)
-    static_cast<ParameterNodeBase*>(cg.nodes[i])->accumulate_grad(ndEdfs[i]);
+    if (i < num_nodes && needed[i])
+      static_cast<ParameterNodeBase*>(cg.nodes[i])->accumulate_grad(ndEdfs[i]);
   backward_computed = from_where;
+}
+
+// Measured execution times of batches, used by autobatching strategy 4.
+// The time of a batch of n nodes with the same type and dimensions is
+// modeled as a + b*n by least squares over all batches seen so far, and
+// concatenating inputs as a fixed cost per float. Only the floats that
+// batches of the type actually copied are charged, since arguments that
+// arrange_batches() made contiguous are used in place.
+struct BatchCostModel {
+  struct Fit {
+    Fit() : cnt(0), sn(0), st(0), snn(0), snt(0), batched(0), copied(0) {}
+    double cnt, sn, st, snn, snt;
+    double batched, copied; // nodes in batches of more than one, and floats they copied
+  };
+  BatchCostModel() : concat_time(0), concat_floats(0) {}
+
+  static size_t key(int type, const Dim& d) {
+    size_t h = (size_t)type;
+    for(unsigned i = 0; i < d.nd; ++i)
+      h = h * 31 + d.d[i];
+    return h * 31 + d.bd;
+  }
+  // t excludes the time spent concatenating the copied floats
+  void add(int type, const Dim& d, unsigned n, double t, size_t copied) {
+    Fit & f = fits[key(type, d)];
+    f.cnt += 1; f.sn += n; f.st += t; f.snn += (double)n * n; f.snt += n * t;
+    if(n > 1) { f.batched += n; f.copied += copied; }
+  }
+  void add_concat(size_t floats, double t) {
+    concat_floats += floats; concat_time += t;
+  }
+  // predicted time to execute n nodes of the given type and dimensions,
+  // or a negative number if they have never been measured
+  double predict(int type, const Dim& d, unsigned n) const {
+    if(n == 0) return 0;
+    auto it = fits.find(key(type, d));
+    if(it == fits.end()) return -1;
+    const Fit & f = it->second;
+    double a = f.st / f.cnt, b = 0;
+    const double det = f.cnt * f.snn - f.sn * f.sn;
+    // with a single batch size, assume the time is dominated by overhead
+    if(det > 1e-6) {
+      b = max(0.0, (f.cnt * f.snt - f.sn * f.st) / det);
+      a = max(0.0, (f.st - b * f.sn) / f.cnt);
+    }
+    double t = a + b * n;
+    if(n > 1 && concat_floats > 0 && f.batched > 0)
+      t += concat_time / concat_floats * n * (f.copied / f.batched);
+    return t;
+  }
+
+  unordered_map<size_t, Fit> fits;
+  double concat_time, concat_floats;
+};
+static thread_local BatchCostModel batch_costs;
+
+// Batching plans are cached across graphs, keyed on everything the schedule
+// depends on: the strategy, node signatures and types, dimensions and edges.
+struct BatchPlan {
+  vector<int> key;
+  vector<vector<VariableIndex> > ids;    // ids of the nodes in each batch
+  vector<vector<int> > concat;           // concat decisions for each batch
+  vector<size_t> node2offset;            // offsets of the new nodes in their batch
+};
+static unordered_map<size_t, shared_ptr<const BatchPlan> > batch_plans;
+static size_t batch_plan_reuses = 0;
+static mutex batch_plans_mutex;
+
+static inline void add_plan_dim(vector<int>& key, const Dim& d) {
+  key.push_back(-(int)d.nd);
+  for(unsigned i = 0; i < d.nd; ++i)
+    key.push_back((int)d.d[i]);
+  key.push_back((int)d.bd);
+}
 
+static size_t hash_plan_key(const vector<int>& key) {
+  size_t h = key.size();
+  for(int k : key)
+    h ^= (size_t)k + 0x9e3779b9 + (h << 6) + (h >> 2);
+  return h;
+}
+
+static shared_ptr<const BatchPlan> find_batch_plan(size_t h, const vector<int>& key) {
+  lock_guard<mutex> lk(batch_plans_mutex);
+  auto it = batch_plans.find(h);
+  if(it != batch_plans.end() && it->second->key == key) {
+    ++batch_plan_reuses;
+    return it->second;
+  }
+  return nullptr;
+}
+
+size_t BatchedExecutionEngine::num_plan_reuses() {
+  lock_guard<mutex> lk(batch_plans_mutex);
+  return batch_plan_reuses;
+}
+
+static void save_batch_plan(size_t h, shared_ptr<const BatchPlan> plan) {
+  lock_guard<mutex> lk(batch_plans_mutex);
+  if(batch_plans.size() >= DYNET_MAX_BATCH_PLANS)
+    batch_plans.clear();
+  batch_plans[h] = plan;
 }
 
 // copies the list of tensors into a single contig tensor (tout).
 // allocates the memory for tout.
 void BatchedExecutionEngine::combine_tensors(std::vector<VariableIndex> batch_ids, int aid, Tensor &tout) {
 
-  AlignedMemoryPool *mempool = tout.device->pools[(int)DeviceMempool::FXS];
   // determine needed memory
   VariableIndex vid;
   unsigned total_dsize = 0;
@@ -228,8 +940,8 @@ void BatchedExecutionEngine::combine_tensors(std::vector<VariableIndex> batch_id
   }
   tout.d = Dim({total_dsize});
 
-  // allocate
-  float* dest = static_cast<float*>(mempool->allocate(total_dsize * sizeof(float)));
+  // allocate, unless the tensor already has its memory from a previous run
+  float* dest = tout.v != nullptr ? tout.v : static_cast<float*>(allocate_fxs(tout.device, total_dsize * sizeof(float)));
 
 #if HAVE_CUDA
   vector<float*> locs(batch_ids.size()*3);
@@ -286,7 +998,7 @@ void BatchedExecutionEngine::accumulate_tensors(const Tensor& tin, std::vector<V
     src += sz; // pointer arith
   }
   size_t req_sz = batch_ids.size()*3*sizeof(float*);
-  AlignedMemoryPool *mempool = tin.device->pools[(int)DeviceMempool::DEDFS];
+  AlignedMemoryPool *mempool = tin.device->pool(DeviceMempool::DEDFS);
   float** srcs = static_cast<float**>(mempool->allocate(req_sz));
   float** trgs = srcs + TRG;
   float** lens = srcs + LEN;
@@ -316,6 +1028,7 @@ void BatchedExecutionEngine::invalidate() {
 
 void BatchedExecutionEngine::invalidate(unsigned i) {
   num_nodes_evaluated = i;
+  fxs_recyclers.clear();
 }
 
 const Tensor& BatchedExecutionEngine::forward() {
@@ -330,6 +1043,8 @@ const Tensor& BatchedExecutionEngine::forward(VariableIndex i) {
 
 const Tensor& BatchedExecutionEngine::get_value(VariableIndex i) {
   DYNET_ASSERT(i < cg.nodes.size(), "Out-of-bounds variable access in BatchedExecutionEngine::get_value()");
+  if (!cg.nodes[i]->has_value())
+    DYNET_RUNTIME_ERR("Requested value of node " << i << ", which was removed by graph_optimize()");
   if (i >= num_nodes_evaluated) {
     incremental_forward();
   }
@@ -358,8 +1073,7 @@ void BatchedExecutionEngine::garbage_collect() {
       if(batch.concat[i])
         delete batch.arg_nfxs[i];
   }
-  for(Device* dev : dynet::devices)
-    dev->pools[(int)DeviceMempool::FXS]->free();
+  free_fxs();
   batches.clear();
 }
 
@@ -381,69 +1095,120 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
     VariableIndex batch_id = num_batches_evaluated;
     batches.resize(upto - num_nodes_evaluated + num_batches_evaluated + 1);
 
-    // Allocate temporary memory for bookkeeping
-    size_t temp_data_size = (uptop1)*4*sizeof(int) + (upto+2)*2*sizeof(float);
+    // Allocate temporary memory for bookkeeping. It is indexed by the
+    // position of each node after the first new one, so that the cost of an
+    // incremental call, e.g. one step of decoding, only depends on the number
+    // of new nodes and not on the size of the graph.
+    const VariableIndex first_node = node_id, first_batch = batch_id;
+    const size_t num_new = uptop1 - first_node;
+    size_t temp_data_size = num_new*4*sizeof(int);
     int* node2profid = (int*)malloc(temp_data_size);
     memset(node2profid, 0, temp_data_size);
-    int* node2left = node2profid + uptop1;
-    int* node2depth = node2left + uptop1;
-    int* active_un_begin = node2depth + uptop1;
+    int* node2left = node2profid + num_new;
+    int* node2depth = node2left + num_new;
+    int* active_un_begin = node2depth + num_new;
     int* active_un_end = active_un_begin;
-    float* prof2avg = (float*)(active_un_begin + uptop1);
-    float* prof2cnt = prof2avg + upto - node_id + 2;
 
+    // 0) Calculate the signatures of the new nodes, and check whether a graph
+    //    of the same structure has already been scheduled. The key refers to
+    //    the new nodes relative to the first one and does not distinguish
+    //    between earlier nodes of the same dimensions, so every step of
+    //    decoding that adds the same kind of nodes reuses the same plan.
+    shared_ptr<BatchPlan> plan_key(new BatchPlan);
+    auto & key = plan_key->key;
+    key.reserve(num_new * 8 + 2);
+    key.push_back(autobatch_strategy);
+    key.push_back((int)num_new);
+    for (VariableIndex j = first_node; j <= upto; ++j) {
+      const Node* node = cg.nodes[j];
+      node2size[j] = node->has_value() ? node->dim.size() : 0;
+      const int sig = node->autobatch_sig(cg, sigmap);
+      node2profid[j - first_node] = sig;
+      key.push_back(sig);
+      key.push_back(sigmap.sig2type(sig));
+      add_plan_dim(key, node->dim);
+      key.push_back(node->arity());
+      for (VariableIndex arg : node->args) {
+        if (arg < first_node) {
+          key.push_back(-1);
+          add_plan_dim(key, cg.nodes[arg]->dim);
+        } else {
+          key.push_back(arg - first_node);
+        }
+      }
+    }
+    const size_t num_sigs = sigmap.size();
+    const size_t plan_hash = hash_plan_key(key);
+    shared_ptr<const BatchPlan> plan = find_batch_plan(plan_hash, key);
+    // schedules of strategy 4 made without costs are not worth keeping
+    bool planned_by_cost = true;
+
+    if(plan) {
+      for(auto & ids : plan->ids) {
+        auto & batch_ids = batches[batch_id].ids;
+        batch_ids.resize(ids.size());
+        for(size_t k = 0; k < ids.size(); ++k) {
+          batch_ids[k] = (VariableIndex)(first_node + ids[k]);
+          node2batch[batch_ids[k]] = batch_id;
+        }
+        ++batch_id;
+      }
+      node_id = uptop1;
     // More intelligent batching?
-    if(autobatch_strategy == 1 || autobatch_strategy == 3) {
+    } else if(autobatch_strategy == 1 || autobatch_strategy == 3 || autobatch_strategy == 4) {
 
-      unordered_map<int, int> depthprofcnt(upto*3);             // Count of remaining things for this profile
-      vector<VariableIndex> node2successors(uptop1,(VariableIndex)0); // Node to successors
-      vector<VariableIndex> active_batched(uptop1*2,(VariableIndex)0);
+      unordered_map<int, int> depthprofcnt(num_new*3);          // Count of remaining things for this profile
+      vector<VariableIndex> node2successors(num_new,(VariableIndex)0); // Node to successors
+      vector<VariableIndex> active_batched(num_sigs*2,(VariableIndex)0);
+      vector<float> prof2avg(num_sigs, 0.f), prof2cnt(num_sigs, 0.f);
       VariableIndex n2sptr, abptr, abmax = (VariableIndex)0;
 
       // 1) Calculate the batching profiles for every node
       int sig = 0, depth;
       for (VariableIndex j = num_nodes_evaluated; j <= upto; ++j) {
         const Node* node = cg.nodes[j];
-        node2size[j] = node->dim.size();
         // Count the remaining input nodes to be computed for each node
         depth = 0;
         for (VariableIndex arg : node->args) {
           if(arg >= node_id) {
-            node2left[j]++;
-            n2sptr = node2successors[arg];
+            node2left[j - first_node]++;
+            n2sptr = node2successors[arg - first_node];
             node2successors.push_back(j);
-            node2successors[arg] = node2successors.size();
+            node2successors[arg - first_node] = node2successors.size();
             node2successors.push_back(n2sptr);
-            depth = max(node2depth[arg]+1,depth);
+            depth = max(node2depth[arg - first_node]+1,depth);
           }
         }
-        node2depth[j] = depth;
+        node2depth[j - first_node] = depth;
         // Get the node profile ID
-        sig = node->autobatch_sig(cg, sigmap);
+        sig = node2profid[j - first_node];
         // If batchable, collect statistics
         if (sig != 0) {
-          node2profid[j] = sig; 
           if(autobatch_strategy == 3) {
-            ++depthprofcnt[(depth * upto) + sig];
+            ++depthprofcnt[(depth * num_sigs) + sig];
           }
           abmax = (VariableIndex)max((int)abmax, sig+1);
           prof2avg[sig] += depth;
           prof2cnt[sig]++;
           if(depth == 0) {
             abptr = active_batched[sig];
-            ++active_batched[sig+uptop1];
+            ++active_batched[sig+num_sigs];
             active_batched.push_back(j);
             active_batched[sig] = active_batched.size();
             active_batched.push_back(abptr);
             if(autobatch_strategy == 3)
               --depthprofcnt[sig];
           }
-        } else if(node2left[j] == 0) {
+        } else if(node2left[j - first_node] == 0) {
           *(active_un_end++) = j;
         }
       }
-      for(size_t j = 0; j < (size_t)sigmap.size(); ++j)
+      for(size_t j = 0; j < num_sigs; ++j)
         prof2avg[j] /= prof2cnt[j];
+      // remaining nodes of each profile, for the cost model
+      vector<unsigned> prof2left;
+      if(autobatch_strategy == 4)
+        prof2left.assign(prof2cnt.begin(), prof2cnt.end());
 
       // 2) Travel through and do active nodes
       while(node_id != (VariableIndex)uptop1) {
@@ -458,21 +1223,49 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
           curr_node = *(active_un_begin++);
         } else {
           float best_avg = 1e10;
-          for(size_t profid = 1; profid < (size_t)abmax; ++profid) {
-            const float avg = prof2avg[profid];
-            if(active_batched[profid] != (VariableIndex)0 &&
-               (best_avg > avg || (best_avg == avg && sigmap.sig2type(profid)<nt::COMPLEX )) && // tie-break on type, defer affine and matmul
-               (autobatch_strategy == 1 || depthprofcnt[(node2depth[active_batched[active_batched[profid]-1]] * upto) + profid] == 0)) {
-              curr_prof = profid;
-              best_avg = avg;
-            } 
+          // With the cost model, pick the profile where executing the ready
+          // nodes now costs the least compared to waiting until all nodes of
+          // the profile are ready. This is zero if they are all ready, and
+          // otherwise roughly the overhead of one more batch. Profiles that
+          // were never measured fall back to the heuristic.
+          if(autobatch_strategy == 4) {
+            double best_regret = 1e10;
+            for(size_t profid = 1; profid < (size_t)abmax; ++profid) {
+              if(active_batched[profid] == (VariableIndex)0) continue;
+              const Node* exemplar = cg.nodes[active_batched[active_batched[profid]-1]];
+              const int type = sigmap.sig2type(profid);
+              const unsigned ready = active_batched[profid+num_sigs], left = prof2left[profid];
+              const double now = batch_costs.predict(type, exemplar->dim, ready);
+              if(now < 0) { curr_prof = -1; planned_by_cost = false; break; }
+              const double regret = now + batch_costs.predict(type, exemplar->dim, left - ready) - batch_costs.predict(type, exemplar->dim, left);
+              const float avg = prof2avg[profid];
+              if(regret < best_regret - 1e-9 || (regret < best_regret + 1e-9 && avg < best_avg)) {
+                curr_prof = profid;
+                best_regret = regret;
+                best_avg = avg;
+              }
+            }
           }
+          if(curr_prof == -1) {
+            best_avg = 1e10;
+            for(size_t profid = 1; profid < (size_t)abmax; ++profid) {
+              const float avg = prof2avg[profid];
+              if(active_batched[profid] != (VariableIndex)0 &&
+                 (best_avg > avg || (best_avg == avg && sigmap.sig2type(profid)<nt::COMPLEX )) && // tie-break on type, defer affine and matmul
+                 (autobatch_strategy != 3 || depthprofcnt[(node2depth[active_batched[active_batched[profid]-1] - first_node] * num_sigs) + profid] == 0)) {
+                curr_prof = profid;
+                best_avg = avg;
+              } 
+            }
+          }
+          if(autobatch_strategy == 4)
+            prof2left[curr_prof] -= active_batched[curr_prof+num_sigs];
 
           abptr = active_batched[curr_prof];
           if(active_batched[abptr] == 0) {
             curr_node = active_batched[abptr-1];
             active_batched[curr_prof] = 0;
-            active_batched[curr_prof + uptop1] = 0;
+            active_batched[curr_prof + num_sigs] = 0;
             curr_prof = -1;
           }
         }
@@ -485,22 +1278,22 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
           // Increment the counts
           node2batch[curr_node] = batch_id;
           // Decrement the counts of the predecessors and add them to the active queue as appropriate
-          n2sptr = node2successors[curr_node];
+          n2sptr = node2successors[curr_node - first_node];
           while(n2sptr != (VariableIndex)0) {
             auto next_node = node2successors[n2sptr-1];
             n2sptr = node2successors[n2sptr];
-            if(--node2left[next_node] == 0) {
-              auto profid = node2profid[next_node];
+            if(--node2left[next_node - first_node] == 0) {
+              auto profid = node2profid[next_node - first_node];
               if(profid == 0) {
                 *(active_un_end++) = next_node;
               } else {
                 abptr = active_batched[profid];
-                ++active_batched[profid+uptop1];
+                ++active_batched[profid+num_sigs];
                 active_batched.push_back(next_node);
                 active_batched[profid] = active_batched.size();
                 active_batched.push_back(abptr);
                 if(autobatch_strategy == 3)
-                  --depthprofcnt[(node2depth[next_node] * upto) + profid];
+                  --depthprofcnt[(node2depth[next_node - first_node] * num_sigs) + profid];
               }
             }
           }
@@ -513,35 +1306,35 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
           // Copy the things from the linked list to the actual batch
           abptr = active_batched[curr_prof];
           assert(abptr != (VariableIndex)0);
-          my_batch.ids.resize(active_batched[curr_prof+uptop1]);
+          my_batch.ids.resize(active_batched[curr_prof+num_sigs]);
           for(auto it = my_batch.ids.rbegin(); it != my_batch.ids.rend(); ++it) {
             *it = active_batched[abptr-1];
             abptr = active_batched[abptr];
           }
           active_batched[curr_prof] = 0;
-          active_batched[curr_prof+uptop1] = 0;
+          active_batched[curr_prof+num_sigs] = 0;
           auto & batch_ids = my_batch.ids;
           // Decrement the counts of the predecessors and add them to the active queue as appropriate
           size_t batch_ids_size = batch_ids.size();
           for(size_t j = 0; j < batch_ids_size; ++j) {
             VariableIndex curr_node = batch_ids[j];
             node2batch[curr_node] = batch_id;
-            n2sptr = node2successors[curr_node];
+            n2sptr = node2successors[curr_node - first_node];
             while(n2sptr != (VariableIndex)0) {
               auto next_node = node2successors[n2sptr-1];
               n2sptr = node2successors[n2sptr];
-              if(--node2left[next_node] == 0) {
-                auto profid = node2profid[next_node];
+              if(--node2left[next_node - first_node] == 0) {
+                auto profid = node2profid[next_node - first_node];
                 if(profid == 0) {
                   *(active_un_end++) = next_node;
                 } else {
                   abptr = active_batched[profid];
-                  ++active_batched[profid+uptop1];
+                  ++active_batched[profid+num_sigs];
                   active_batched.push_back(next_node);
                   active_batched[profid] = active_batched.size();
                   active_batched.push_back(abptr);
                   if(autobatch_strategy == 3)
-                    --depthprofcnt[(node2depth[next_node] * upto) + profid];
+                    --depthprofcnt[(node2depth[next_node - first_node] * num_sigs) + profid];
                 }
               }
             }
@@ -562,10 +1355,9 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
         depth = 0;
         node = cg.nodes[j];
         for (auto k : node->args)
-          depth = max(node2depth[k]+1,depth);
-        node2depth[j] = depth;
-        node2size[j] = node->dim.size();
-        sig = node->autobatch_sig(cg, sigmap);
+          depth = max((k >= first_node ? node2depth[k - first_node] : 0)+1,depth);
+        node2depth[j - first_node] = depth;
+        sig = node2profid[j - first_node];
         depth_profile_batches[make_pair(depth, sig)].push_back(j); 
       }
       for(auto & batch_info : depth_profile_batches) {
@@ -595,7 +1387,60 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
       }
     }
 
+    // 2.75 Decide which arguments of the batches need to be concatenated, and
+    //      arrange the batches so that as many as possible are contiguous
+    for(VariableIndex bid = first_batch; bid < batch_id; ++bid) {
+      auto & my_batch = batches[bid];
+      if(my_batch.ids.size() > 1)
+        my_batch.concat = plan ? plan->concat[bid - first_batch] : cg.nodes[my_batch.ids[0]]->autobatch_concat(cg);
+    }
+    vector<vector<VariableIndex> > groups;
+    arrange_batches(first_batch, batch_id, groups);
+
     // 3. Based on the batches, allocate the memory, etc
+    // Unless memory is recycled, the memory of all the new batches is laid
+    // out first and allocated with one request per device. The values of the
+    // batches in a group are laid out back to back, without alignment.
+    const bool planned = !cg.is_inference_mode() && !cg.is_recompute();
+    MemoryPlan mem_plan;
+    vector<size_t> main_offsets(batch_id - first_batch), aux_offsets(batch_id - first_batch, 0);
+    if(planned) {
+      vector<int> batch2group(batch_id - first_batch, -1);
+      for(size_t g = 0; g < groups.size(); ++g)
+        for(auto bid : groups[g])
+          batch2group[bid - first_batch] = g;
+      for(VariableIndex bid = first_batch; bid < batch_id; ++bid) {
+        const Node* node = nullptr;
+        size_t tot_main = 0, tot_aux = 0;
+        for(auto curr_node : batches[bid].ids) {
+          node = cg.nodes[curr_node];
+          tot_main += node2size[curr_node];
+          tot_aux += node->aux_storage_size();
+        }
+        const int g = batch2group[bid - first_batch];
+        if(g < 0) {
+          main_offsets[bid - first_batch] = mem_plan.place(node->device, tot_main * sizeof(float));
+        } else if(groups[g][0] == bid) {
+          size_t tot_group = 0;
+          for(auto member : groups[g])
+            tot_group += node2size[batches[member].ids[0]];
+          size_t offset = mem_plan.place(node->device, tot_group * sizeof(float));
+          for(auto member : groups[g]) {
+            main_offsets[member - first_batch] = offset;
+            offset += node2size[batches[member].ids[0]] * sizeof(float);
+          }
+        }
+        if(tot_aux)
+          aux_offsets[bid - first_batch] = mem_plan.place(node->device, tot_aux);
+      }
+      mem_plan.allocate(DeviceMempool::FXS);
+    }
+    auto batch_main = [&](VariableIndex bid, Device* device, size_t n) {
+      return planned ? mem_plan.address(device, main_offsets[bid - num_batches_evaluated]) : allocate_fxs(device, n);
+    };
+    auto batch_aux = [&](VariableIndex bid, Device* device, size_t n) {
+      return planned ? mem_plan.address(device, aux_offsets[bid - num_batches_evaluated]) : allocate_fxs(device, n);
+    };
     for(VariableIndex bid = num_batches_evaluated; bid < batch_id; ++bid) {
 
       auto & my_batch = batches[bid];
@@ -611,13 +1456,18 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
         nfx.d = node->dim;
         nfx.device = node->device;
         nfx.mem_pool = DeviceMempool::FXS;
+        // nodes removed by graph_optimize() get no memory
+        if (!node->has_value()) {
+          nfx.v = nullptr;
+          continue;
+        }
         // Allocate memory
-        nfx.v = static_cast<float*>(node->device->pools[(int)DeviceMempool::FXS]->allocate(node2size[curr_node] * sizeof(float)));
+        nfx.v = static_cast<float*>(batch_main(bid, node->device, node2size[curr_node] * sizeof(float)));
         if (nfx.v == nullptr)
           DYNET_RUNTIME_ERR("Ran out of memory when allocating for node " << curr_node);
         size_t aux_size = node->aux_storage_size();
         if (aux_size) {
-          node->aux_mem = node->device->pools[(int)DeviceMempool::FXS]->allocate(aux_size);
+          node->aux_mem = batch_aux(bid, node->device, aux_size);
           if (!node->aux_mem)
             DYNET_RUNTIME_ERR("Ran out of auxiliary memory when allocating for node " << curr_node);
         }
@@ -631,7 +1481,7 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
           node = cg.nodes[curr_node];
           my_main = node2size[curr_node];
           my_aux = node->aux_storage_size();
-          node2offset[curr_node] = tot_main;
+          node2offset[curr_node] = plan ? plan->node2offset[curr_node - first_node] : tot_main;
           tot_main += my_main;
           node->aux_mem = (void*)my_aux;
           tot_aux += my_aux;
@@ -639,20 +1489,19 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
 
 
         // Allocate main/auxiliary memory for the batch
-        float *head_main = static_cast<float*>(node->device->pools[(int)DeviceMempool::FXS]->allocate(tot_main * sizeof(float)));
+        float *head_main = static_cast<float*>(batch_main(bid, node->device, tot_main * sizeof(float)));
         if(head_main == nullptr) DYNET_RUNTIME_ERR("Ran out of memory when executing batch " << bid);
         // for(auto curr_node : batch_ids)
         //   nfxs[curr_node].v = head_main + node2diff[curr_node];
         void *head_aux = nullptr;
         if(tot_aux > 0) {
-          head_aux = static_cast<void*>(node->device->pools[(int)DeviceMempool::FXS]->allocate(tot_aux));
+          head_aux = batch_aux(bid, node->device, tot_aux);
           if(head_aux == nullptr) DYNET_RUNTIME_ERR("Ran out of memory when executing node " << bid);
           for(auto curr_node : batch_ids)
             cg.nodes[curr_node]->aux_mem = (void*)((ptrdiff_t)head_aux + (ptrdiff_t)cg.nodes[curr_node]->aux_mem);
         }
 
-        // Get the concatenation and pseudo-node info
-        my_batch.concat = node->autobatch_concat(cg);
+        // Get the pseudo-node info
         my_batch.pseudo_node = node->autobatch_pseudo_node(cg, batch_ids);
         if(my_batch.pseudo_node != nullptr)
           my_batch.pseudo_node->aux_mem = head_aux;
@@ -669,12 +1518,53 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
 
     }
 
+    // 3.5 Save the plan for graphs of the same structure
+    if(!plan && planned_by_cost) {
+      plan_key->node2offset.assign(node2offset.begin() + first_node, node2offset.begin() + uptop1);
+      for(VariableIndex bid = first_batch; bid < batch_id; ++bid) {
+        plan_key->ids.push_back(batches[bid].ids);
+        for(auto & id : plan_key->ids.back())
+          id = (VariableIndex)(id - first_node);
+        plan_key->concat.push_back(batches[bid].concat);
+      }
+      save_batch_plan(plan_hash, plan_key);
+    }
+
+    // 3.6 In inference mode, count the uses of each new batch by nodes in
+    //     other new batches. A batch is recycled after its last use, unless
+    //     one of its nodes is requested or not used by any node.
+    const bool recycle = cg.is_inference_mode();
+    vector<unsigned> batch_uses;
+    if (recycle) {
+      batch_uses.resize(batch_id - first_batch, 0);
+      vector<bool> used(uptop1 - first_node, false);
+      for (VariableIndex j = first_node; j <= upto; ++j) {
+        for (VariableIndex arg : cg.nodes[j]->args) {
+          if (arg >= first_node) {
+            used[arg - first_node] = true;
+            if (node2batch[arg] != node2batch[j])
+              ++batch_uses[node2batch[arg] - first_batch];
+          }
+        }
+      }
+      used[upto - first_node] = false;
+      for (VariableIndex j = first_node; j <= upto; ++j)
+        if (!used[j - first_node])
+          batch_uses[node2batch[j] - first_batch] = UINT_MAX;
+    }
+
     // 4: do the actual execution 
     Tensor temp_nfx;
     vector<const Tensor*> xs(16), ts(16);
+    const bool measure = (autobatch_strategy == 4);
+    Timing batch_timer;
     while(num_batches_evaluated < batch_id) {
       // Read in the stuff for this batch
       auto & my_batch = batches[num_batches_evaluated];
+      // concatenation is measured on its own, and left out of the batch time
+      double concat_time = 0;
+      size_t copied = 0;
+      if (measure) batch_timer.start();
       if (autobatch_debug_flag) { 
         VariableIndex nid = my_batch.ids[0];
         Node* node = cg.nodes[nid];
@@ -707,7 +1597,7 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
           // 2) the inputs need to be concatenated
           } else {
             // 2.a) the inputs need to be concatenated, but are already in the right order within a contiguous block of memory
-            // TODO: make this work completely
+            //      (arrange_batches() lays out as many arguments as possible this way)
             Tensor* my_xsi = new Tensor;
             my_xsi->device = node->device;
             my_xsi->mem_pool = DeviceMempool::FXS;
@@ -732,7 +1622,14 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
             //   autobatch_garbage[i] = false;
             } else { // if non-contig, copy xs_i into new mem.
               // 2.b) the inputs need to be concatenated, and are not contiguous
+              Timing concat_timer;
               combine_tensors(my_batch.ids, i, *my_xsi);
+              if (measure) {
+                const double t = concat_timer.stop();
+                batch_costs.add_concat(my_xsi->d.size(), t);
+                concat_time += t;
+                copied += my_xsi->d.size();
+              }
             }
             my_batch.arg_nfxs[i] = my_xsi;
           }
@@ -744,6 +1641,12 @@ const Tensor& BatchedExecutionEngine::incremental_forward_no_update(VariableInde
         ++num_batches_evaluated;
 
       }
+      if (measure && node2profid[my_batch.ids[0] - first_node] != 0) {
+        const Node* exemplar = cg.nodes[my_batch.ids[0]];
+        batch_costs.add(sigmap.sig2type(node2profid[my_batch.ids[0] - first_node]), exemplar->dim, my_batch.ids.size(), batch_timer.stop() - concat_time, copied);
+      }
+      if (recycle)
+        recycle_batch_inputs((VariableIndex)(num_batches_evaluated - 1), first_node, first_batch, batch_uses);
       if (autobatch_debug_flag) { timer.stop(current_batch_name); }
     }
 
@@ -765,7 +1668,11 @@ const Tensor& BatchedExecutionEngine::incremental_forward(VariableIndex i) {
     incremental_forward_no_update(i, 1);
     double best_speed = timer.stop();
     autobatch_flag = 1;
-    for(size_t strat = 2; strat < 4; ++strat) {
+    for(size_t strat = 2; strat < 5; ++strat) {
+      // strategy 4 schedules with measured costs, so it runs once to record
+      // them before it is timed. Otherwise it falls back to the heuristic.
+      if(strat == 4)
+        incremental_forward_no_update(i, strat);
       timer.start();
       incremental_forward_no_update(i, strat);
       double speed = timer.stop();
@@ -782,6 +1689,49 @@ const Tensor& BatchedExecutionEngine::incremental_forward(VariableIndex i) {
   return get_nfx(i);
 }
 
+// executes all the evaluated batches again, in their memory and with the
+// arguments that were arranged for them
+const Tensor& BatchedExecutionEngine::rerun(VariableIndex i) {
+  DYNET_ASSERT(i < cg.nodes.size(), "Out-of-bounds variable access in BatchedExecutionEngine::rerun()");
+  // memory that was recycled cannot be reused
+  if (i >= num_nodes_evaluated || cg.is_inference_mode() || cg.is_recompute())
+    return forward(i);
+  backward_computed = 0;
+  vector<const Tensor*> xs;
+  for (VariableIndex bid = (VariableIndex)0; bid < num_batches_evaluated; ++bid) {
+    auto & my_batch = batches[bid];
+    if (my_batch.ids.size() == 1) {
+      Node* node = cg.nodes[my_batch.ids[0]];
+      xs.resize(node->arity());
+      unsigned ai = 0;
+      for (VariableIndex arg : node->args)
+        xs[ai++] = &get_nfx(arg);
+      node->forward(xs, my_batch.nfx);
+    } else {
+      Node* node = cg.nodes[my_batch.ids[0]];
+      // pseudo nodes hold copies of the data of the batched inputs and
+      // lookups, so they are created again from the current data
+      if (my_batch.pseudo_node != nullptr) {
+        Node* pseudo_node = node->autobatch_pseudo_node(cg, my_batch.ids);
+        pseudo_node->aux_mem = my_batch.pseudo_node->aux_mem;
+        delete my_batch.pseudo_node;
+        my_batch.pseudo_node = pseudo_node;
+        node = pseudo_node;
+      }
+      // arguments that were copied together are copied again, in place
+      for (size_t ai = 0; ai < my_batch.concat.size(); ++ai) {
+        if (my_batch.concat[ai] == 1) {
+          Tensor& arg_nfx = const_cast<Tensor&>(*my_batch.arg_nfxs[ai]);
+          combine_tensors(my_batch.ids, ai, arg_nfx);
+        }
+      }
+      node->autobatch_reshape(cg, my_batch.ids, my_batch.concat, my_batch.arg_nfxs, my_batch.nfx);
+      node->forward(my_batch.arg_nfxs, my_batch.nfx);
+    }
+  }
+  return get_nfx(i);
+}
+
 void BatchedExecutionEngine::backward(bool full) {
   DYNET_ASSERT(nfx_cache.size() >= cg.nodes.size(), "Mismatched array sizes in BatchedExecutionEngine::backward");
   backward((VariableIndex)(cg.nodes.size()-1),full);
@@ -789,6 +1739,8 @@ void BatchedExecutionEngine::backward(bool full) {
 
 // TODO what is happening with parameter nodes if from_where > param_node_id ?
 void BatchedExecutionEngine::backward(VariableIndex from_where, bool full) {
+  if (cg.is_inference_mode())
+    DYNET_RUNTIME_ERR("backward() cannot be called on a ComputationGraph in inference mode");
 
   if(!(from_where < node2batch.size()))
     incremental_forward(from_where);
@@ -815,16 +1767,53 @@ void BatchedExecutionEngine::backward(VariableIndex from_where, bool full) {
   vector<Tensor> batched_ndEdfs(num_batches);
   ndEdfs.resize(node2batch.size());
   for(Device* device : devices)
-    device->pools[(int)DeviceMempool::DEDFS]->free();
+    device->pool(DeviceMempool::DEDFS)->free();
+  // The gradients of batches whose values are adjacent in memory are laid
+  // out back to back too, so that arguments that were used in place in the
+  // forward pass can also receive their gradients in place. Batches of nodes
+  // that graph_optimize() fused away have no value, and get no gradient.
+  MemoryPlan mem_plan;
+  vector<size_t> offsets(num_batches);
+  vector<int> next(num_batches, -1);
+  vector<bool> has_prev(num_batches, false);
+  unordered_map<const float*, unsigned> starts;
+  for (unsigned i = 0; i < num_batches; ++i)
+    if (batches[i].nfx.v != nullptr && batches[i].nfx.d.size() > 0)
+      starts[batches[i].nfx.v] = i;
+  for (unsigned i = 0; i < num_batches; ++i) {
+    const Tensor & nfx = batches[i].nfx;
+    if (nfx.v == nullptr || nfx.d.size() == 0) continue;
+    auto it = starts.find(nfx.v + nfx.d.size());
+    if (it != starts.end() && batches[it->second].nfx.device == nfx.device && !has_prev[it->second]) {
+      next[i] = it->second;
+      has_prev[it->second] = true;
+    }
+  }
+  for (unsigned i = 0; i < num_batches; ++i) {
+    if (has_prev[i] || batches[i].nfx.v == nullptr) continue;
+    size_t tot = 0;
+    for (int j = i; j != -1; j = next[j])
+      tot += batches[j].nfx.d.size();
+    size_t offset = mem_plan.place(cg.nodes[batches[i].ids[0]]->device, tot * sizeof(float));
+    for (int j = i; j != -1; j = next[j]) {
+      offsets[j] = offset;
+      offset += batches[j].nfx.d.size() * sizeof(float);
+    }
+  }
+  mem_plan.allocate(DeviceMempool::DEDFS);
   for (unsigned i = 0; i < num_batches; ++i) {
     const auto & my_batch = batches[i];
     const auto & dim = my_batch.nfx.d;
     batched_ndEdfs[i].d = dim;
     batched_ndEdfs[i].device = cg.nodes[my_batch.ids[0]]->device;
     batched_ndEdfs[i].mem_pool = DeviceMempool::DEDFS;
-    batched_ndEdfs[i].v = static_cast<float*>(batched_ndEdfs[i].device->pools[(int)DeviceMempool::DEDFS]->allocate(dim.size() * sizeof(float)));
-    if (!batched_ndEdfs[i].v)
-      DYNET_RUNTIME_ERR("out of memory while attempting to allocate space for derivatives of node " << i);
+    if (my_batch.nfx.v == nullptr) {
+      batched_ndEdfs[i].v = nullptr;
+      for(auto id : my_batch.ids)
+        ndEdfs[id].v = nullptr;
+      continue;
+    }
+    batched_ndEdfs[i].v = static_cast<float*>(mem_plan.address(batched_ndEdfs[i].device, offsets[i]));
     // Assign the memory within the batch
     for(auto id : my_batch.ids) {
       ndEdfs[id].d = cg.nodes[id]->dim;
@@ -834,7 +1823,7 @@ void BatchedExecutionEngine::backward(VariableIndex from_where, bool full) {
     }
   }
   for(Device* device : devices)
-    device->pools[(int)DeviceMempool::DEDFS]->zero_allocated_memory();
+    device->pool(DeviceMempool::DEDFS)->zero_allocated_memory();
 
   // initialize dE/dE = 1
   size_t final_size = batched_ndEdfs.back().d.size();
@@ -925,21 +1914,21 @@ void BatchedExecutionEngine::backward(VariableIndex from_where, bool full) {
           if (nd) {
             // Non-contiguous
             Tensor my_ndEdf = *xs[ai];
-            if (my_batch.concat[ai] == 1) {
-              size_t used = node->device->pools[(int)DeviceMempool::DEDFS]->used();
-              my_ndEdf.v = static_cast<float*>(batched_ndEdfs[i].device->pools[(int)DeviceMempool::DEDFS]->allocate(my_ndEdf.d.size() * sizeof(float)));
+            float* contig = (my_batch.concat[ai] == 2 ? contiguous_gradients(my_batch, ai, batched_ndEdfs) : nullptr);
+            if (contig == nullptr) {
+              size_t used = node->device->pool(DeviceMempool::DEDFS)->used();
+              my_ndEdf.v = static_cast<float*>(batched_ndEdfs[i].device->pool(DeviceMempool::DEDFS)->allocate(my_ndEdf.d.size() * sizeof(float)));
               my_ndEdf.mem_pool = DeviceMempool::DEDFS;
               TensorTools::zero(my_ndEdf);
               node->backward(xs, my_batch.nfx, batched_ndEdfs[i], ai, my_ndEdf);
               // cerr << "noncontig backward[" << i << "](" << ai << ")->" << node2batch[arg] << " == "; for(auto id : my_batch.ids) cerr << " ndEdfs[" << cg.nodes[id]->args[ai] << "] == " << print_vec(as_vector(ndEdfs[cg.nodes[id]->args[ai]])); cerr << " + " << print_vec(as_vector(my_ndEdf)) << " == ";
               accumulate_tensors(my_ndEdf, my_batch.ids, ai);
               // for(auto id : my_batch.ids) cerr << " ndEdfs[" << cg.nodes[id]->args[ai] << "] == " << print_vec(as_vector(ndEdfs[cg.nodes[id]->args[ai]])); cerr << endl;
-              node->device->pools[(int)DeviceMempool::DEDFS]->set_used(used);
+              node->device->pool(DeviceMempool::DEDFS)->set_used(used);
             // Contiguous
             } else {
-              VariableIndex aid = cg.nodes[my_batch.ids[0]]->args[ai];
-              float* v = batched_ndEdfs[node2batch[aid]].v + node2offset[aid];
-              my_ndEdf.v = v;
+              my_ndEdf.v = contig;
+              my_ndEdf.mem_pool = DeviceMempool::DEDFS;
               node->backward(xs, my_batch.nfx, batched_ndEdfs[i], ai, my_ndEdf);
               // cerr << "contig backward[" << i << "](" << ai << ")->" << node2batch[arg] << " == "; for(auto id : my_batch.ids) cerr << " ndEdfs[" << cg.nodes[id]->args[ai] << "] == " << print_vec(as_vector(ndEdfs[cg.nodes[id]->args[ai]])); cerr << endl;
             }
@@ -954,17 +1943,172 @@ void BatchedExecutionEngine::backward(VariableIndex from_where, bool full) {
   // this is simpler than you might find in some other frameworks
   // since we assume parameters come into the graph as a "function"
   // that returns the current value of the parameters
-  // TODO: Can this be batched? Maybe not with the current assumptions, but
-  //       it would be nice to have.
-  for (VariableIndex i : cg.parameter_nodes)
-    static_cast<ParameterNodeBase*>(cg.nodes[i])->accumulate_grad(ndEdfs[i]);
+  accumulate_parameter_gradients(batched_ndEdfs);
   backward_computed = from_where;
 
 }
 
+// Accumulates the gradients of the parameter nodes into the parameters.
+// A batch of lookups scatter-adds the gradients of all its nodes in one
+// pass through its pseudo node, and the gradients of parameters that are
+// used by several nodes are summed before they are accumulated once.
+// Constant lookups share the signature of lookups into the same table, so a
+// batch that contains any node outside of cg.parameter_nodes is accumulated
+// node by node instead.
+void BatchedExecutionEngine::accumulate_parameter_gradients(const vector<Tensor>& batched_ndEdfs) {
+  vector<bool> batch_done(batched_ndEdfs.size(), false);
+  vector<bool> is_param(cg.nodes.size(), false);
+  for (VariableIndex i : cg.parameter_nodes)
+    is_param[i] = true;
+  unordered_map<const void*, size_t> storage2uses;
+  vector<vector<VariableIndex> > uses;
+  for (VariableIndex i : cg.parameter_nodes) {
+    const VariableIndex bid = node2batch[i];
+    const auto & my_batch = batches[bid];
+    if (my_batch.ids.size() > 1) {
+      ParameterNodeBase* pseudo = dynamic_cast<ParameterNodeBase*>(my_batch.pseudo_node);
+      if (pseudo != nullptr && all_of(my_batch.ids.begin(), my_batch.ids.end(),
+                                      [&](VariableIndex id) { return is_param[id]; })) {
+        if (!batch_done[bid])
+          pseudo->accumulate_grad(batched_ndEdfs[bid]);
+        batch_done[bid] = true;
+        continue;
+      }
+    }
+    const ParameterNode* pn = dynamic_cast<const ParameterNode*>(cg.nodes[i]);
+    if (pn == nullptr) {
+      static_cast<ParameterNodeBase*>(cg.nodes[i])->accumulate_grad(ndEdfs[i]);
+      continue;
+    }
+    const void* storage = (pn->params.mp != nullptr ? (const void*)pn->params.get() : (const void*)pn->lparams.get());
+    auto it = storage2uses.find(storage);
+    if (it == storage2uses.end()) {
+      it = storage2uses.insert(make_pair(storage, uses.size())).first;
+      uses.push_back(vector<VariableIndex>());
+    }
+    uses[it->second].push_back(i);
+  }
+  for (auto & ids : uses) {
+    ParameterNodeBase* node = static_cast<ParameterNodeBase*>(cg.nodes[ids[0]]);
+    if (ids.size() == 1) {
+      node->accumulate_grad(ndEdfs[ids[0]]);
+      continue;
+    }
+    AlignedMemoryPool* mempool = node->device->pool(DeviceMempool::DEDFS);
+    size_t used = mempool->used();
+    Tensor sum = ndEdfs[ids[0]];
+    sum.v = static_cast<float*>(mempool->allocate(sum.d.size() * sizeof(float)));
+    if (sum.v == nullptr)
+      DYNET_RUNTIME_ERR("out of memory while summing the gradients of node " << ids[0]);
+    TensorTools::copy_elements(sum, ndEdfs[ids[0]]);
+    for (size_t k = 1; k < ids.size(); ++k)
+      TensorTools::accumulate(sum, ndEdfs[ids[k]]);
+    node->accumulate_grad(sum);
+    mempool->set_used(used);
+  }
+}
+
+// Arranges the new batches [first_batch, end_batch) so that the arguments
+// that batched nodes concatenate are already contiguous in memory, and can be
+// used in place instead of being copied:
+// - when the arguments all come from one batch, that batch takes the order
+//   of the nodes that use them
+// - when they all come from singleton batches, those batches are returned
+//   as a group, whose values are laid out back to back
+// Batches are visited from last to first, so that the order given to a
+// batch is passed on to the batches of its own arguments.
+void BatchedExecutionEngine::arrange_batches(VariableIndex first_batch, VariableIndex end_batch, vector<vector<VariableIndex> >& groups) {
+  vector<bool> arranged(end_batch - first_batch, false);
+  vector<VariableIndex> producers, order;
+  unordered_set<unsigned> seen;
+  for(unsigned bid = end_batch; bid-- > first_batch; ) {
+    const auto & my_batch = batches[bid];
+    if(my_batch.ids.size() == 1) continue;
+    for(size_t ai = 0; ai < my_batch.concat.size(); ++ai) {
+      if(!my_batch.concat[ai]) continue;
+      producers.clear();
+      seen.clear();
+      bool distinct = true, singletons = true;
+      for(auto id : my_batch.ids) {
+        const VariableIndex arg = cg.nodes[id]->args[ai];
+        const VariableIndex arg_bid = node2batch[arg];
+        distinct = distinct && arg_bid >= first_batch && arg_bid != bid && !arranged[arg_bid - first_batch] && seen.insert(arg).second;
+        singletons = singletons && batches[arg_bid].ids.size() == 1 && cg.nodes[arg]->device == cg.nodes[id]->device;
+        producers.push_back(arg);
+      }
+      if(!distinct) continue;
+      const VariableIndex arg_bid = node2batch[producers[0]];
+      if(singletons) {
+        groups.push_back(vector<VariableIndex>());
+        for(auto arg : producers) {
+          groups.back().push_back(node2batch[arg]);
+          arranged[node2batch[arg] - first_batch] = true;
+        }
+      } else if(all_of(producers.begin(), producers.end(), [&](VariableIndex arg) { return node2batch[arg] == arg_bid; })) {
+        // the producers first, in the order they are used, then the rest
+        auto & ids = batches[arg_bid].ids;
+        order = producers;
+        for(auto id : ids)
+          if(!seen.count(id))
+            order.push_back(id);
+        ids = order;
+        arranged[arg_bid - first_batch] = true;
+      }
+    }
+  }
+}
+
+// Returns the start of the gradients of the arguments ai of a batch, if they
+// are contiguous in memory, and nullptr otherwise.
+float* BatchedExecutionEngine::contiguous_gradients(const BatchInfo& my_batch, size_t ai, const vector<Tensor>& batched_ndEdfs) const {
+  float* start = nullptr;
+  size_t tot = 0;
+  for(auto id : my_batch.ids) {
+    const VariableIndex aid = cg.nodes[id]->args[ai];
+    float* v = batched_ndEdfs[node2batch[aid]].v + node2offset[aid];
+    if(start == nullptr) start = v;
+    else if(v != start + tot) return nullptr;
+    tot += node2size[aid];
+  }
+  return start;
+}
+
+// Releases the memory that is dead after batch bid has been executed in
+// inference mode: its auxiliary memory and concatenated inputs, and the
+// batches whose last use it was.
+void BatchedExecutionEngine::recycle_batch_inputs(VariableIndex bid, VariableIndex first_node, VariableIndex first_batch, vector<unsigned>& batch_uses) {
+  auto & my_batch = batches[bid];
+  const Node* exemplar = cg.nodes[my_batch.ids[0]];
+  size_t tot_aux = 0;
+  for (auto id : my_batch.ids)
+    tot_aux += cg.nodes[id]->aux_storage_size();
+  if (tot_aux > 0)
+    release_fxs(exemplar->device, (my_batch.pseudo_node != nullptr ? my_batch.pseudo_node->aux_mem : exemplar->aux_mem), tot_aux);
+  for (size_t i = 0; i < my_batch.concat.size(); ++i)
+    if (my_batch.concat[i] == 1)
+      release_fxs(my_batch.arg_nfxs[i]->device, my_batch.arg_nfxs[i]->v, my_batch.arg_nfxs[i]->d.size() * sizeof(float));
+  for (auto id : my_batch.ids) {
+    for (VariableIndex arg : cg.nodes[id]->args) {
+      const VariableIndex arg_bid = node2batch[arg];
+      if (arg < first_node || arg_bid == bid || --batch_uses[arg_bid - first_batch] != 0)
+        continue;
+      auto & dead = batches[arg_bid];
+      size_t sz = 0;
+      for (auto dead_id : dead.ids) {
+        sz += node2size[dead_id];
+        nfx_cache[dead_id].v = nullptr;
+      }
+      release_fxs(dead.nfx.device, dead.nfx.v, sz * sizeof(float));
+      dead.nfx.v = nullptr;
+    }
+  }
+}
+
 const Tensor& BatchedExecutionEngine::get_nfx(VariableIndex i) {
   if(nfx_cache[i].v == nullptr) {
     const Tensor & bt = batches[node2batch[i]].nfx;
+    if(bt.v == nullptr)
+      DYNET_RUNTIME_ERR("Requested value of node " << i << ", but its memory was recycled in inference mode");
     Tensor & t = nfx_cache[i];
     t.v = bt.v + node2offset[i]; 
     t.d = cg.nodes[i]->dim;
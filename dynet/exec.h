@@ -1,10 +1,34 @@
 #ifndef DYNET_EXEC_H
 #define DYNET_EXEC_H
 
+#include <unordered_map>
+
 #include "dynet/dynet.h"
+#include "dynet/aligned-mem-pool.h"
 
 namespace dynet {
 
+// Lays out blocks of memory that are taken from a pool together. Every block
+// is placed at an aligned offset within the region of its device, and the
+// regions are allocated with a single request per device, so the memory a
+// computation needs is known before any of it is taken.
+class MemoryPlan {
+ public:
+  // reserves n bytes on device, and returns their offset in its region
+  size_t place(Device* device, size_t n);
+  // allocates the region of every device from its pool mp
+  void allocate(DeviceMempool mp);
+  void* address(Device* device, size_t offset) const;
+  size_t size(Device* device) const;
+ private:
+  struct Region {
+    Region() : size(0), base(nullptr) {}
+    size_t size;
+    char* base;
+  };
+  std::unordered_map<Device*, Region> regions;
+};
+
 class ExecutionEngine {
  public:
   virtual ~ExecutionEngine();
@@ -15,14 +39,20 @@ class ExecutionEngine {
   virtual std::vector<const Tensor*> forward(std::vector<VariableIndex> is);  // forward on multiple nodes
   virtual const Tensor& incremental_forward() = 0;  // if you want to add nodes and evaluate just the new parts
   virtual const Tensor& incremental_forward(VariableIndex i) = 0;
+  virtual const Tensor& rerun(VariableIndex i) = 0;  // executes the evaluated nodes again in their memory, see ComputationGraph::rerun()
   virtual const Tensor& get_value(VariableIndex i) = 0;
   virtual const Tensor& get_gradient(VariableIndex i) = 0;
   virtual void backward(bool full = false) = 0;
   virtual void backward(VariableIndex i, bool full = false) = 0;
  protected:
   explicit ExecutionEngine(const ComputationGraph& cg) : cg(cg) {}
+  // in inference mode, forward memory is allocated and recycled through these
+  void* allocate_fxs(Device* device, size_t n);
+  void release_fxs(Device* device, void* p, size_t n);
+  void free_fxs();
   const ComputationGraph& cg;
   VariableIndex backward_computed;
+  std::unordered_map<Device*, RecyclingMemoryPool> fxs_recyclers;
 };
 
 class SimpleExecutionEngine : public ExecutionEngine {
@@ -34,16 +64,49 @@ class SimpleExecutionEngine : public ExecutionEngine {
   const Tensor& forward(VariableIndex i) override;
   const Tensor& incremental_forward() override;  // if you want to add nodes and evaluate just the new parts
   const Tensor& incremental_forward(VariableIndex i) override;
+  const Tensor& rerun(VariableIndex i) override;
   const Tensor& get_value(VariableIndex i) override;
   const Tensor& get_gradient(VariableIndex i) override;
   void backward(bool full = false) override;
   void backward(VariableIndex i, bool full = false) override;
- private:
+ protected:
+  void allocate_fx(VariableIndex i);
+  void plan_fxs(VariableIndex first, VariableIndex last);
+  void allocate_gradients(unsigned num_nodes, const std::vector<bool>& needed);
+  void init_gradient(VariableIndex i);
+  std::vector<bool> compute_needs_derivative(unsigned num_nodes, bool full) const;
+  std::vector<bool> compute_in_computation(unsigned num_nodes) const;
+  std::vector<bool> ancestors(VariableIndex first, VariableIndex i) const;
+  void ensure_value(VariableIndex i, std::vector<VariableIndex>& recomputed);
+  bool prepare_rerun(VariableIndex i, std::vector<bool>& needed);
+  // for recomputation, see ComputationGraph::set_recompute()
+  std::vector<VariableIndex> recompute_segments(unsigned num_nodes) const;
+  void discard_value(VariableIndex i);
   std::vector<Tensor> nfxs;
+  std::vector<bool> pending; // values that were not needed yet and have not been computed
   std::vector<Tensor> ndEdfs;
+  // whether dE/df of each node has been zeroed before its first contribution
+  // (chars, since the parallel engine sets them from several threads)
+  std::vector<char> ndEdfs_initialized;
   VariableIndex num_nodes_evaluated;
 };
 
+// Executes nodes whose arguments have all been computed (a "wavefront") in
+// parallel on a shared thread pool, both in the forward and backward pass.
+// Memory is allocated serially in node order and every gradient is
+// accumulated in a fixed order, so results do not depend on thread timing.
+class ParallelExecutionEngine : public SimpleExecutionEngine {
+ public:
+  explicit ParallelExecutionEngine(const ComputationGraph& cg, unsigned num_threads) : SimpleExecutionEngine(cg), num_threads(num_threads) {}
+  const Tensor& incremental_forward(VariableIndex i) override;
+  const Tensor& rerun(VariableIndex i) override;
+  void backward(VariableIndex i, bool full = false) override;
+  using SimpleExecutionEngine::incremental_forward;
+  using SimpleExecutionEngine::backward;
+ private:
+  unsigned num_threads;
+};
+
 struct BatchInfo {
 public:
   BatchInfo() : pseudo_node(nullptr) { }
@@ -64,15 +127,22 @@ class BatchedExecutionEngine : public ExecutionEngine {
   const Tensor& forward(VariableIndex i) override;
   const Tensor& incremental_forward() override;  // if you want to add nodes and evaluate just the new parts
   const Tensor& incremental_forward(VariableIndex i) override;
+  const Tensor& rerun(VariableIndex i) override;
   const Tensor& get_value(VariableIndex i) override;
   const Tensor& get_gradient(VariableIndex i) override;
   void backward(bool full = false) override;
   void backward(VariableIndex i, bool full = false) override;
   void garbage_collect();
+  // number of times a cached batching plan was reused, over all graphs
+  static size_t num_plan_reuses();
  private:
   const Tensor& incremental_forward_no_update(VariableIndex i, int autobatch_strategy);
   void combine_tensors(std::vector<VariableIndex> batch_ids, int aid, Tensor &tout);
   void accumulate_tensors(const Tensor& my_ndEdf, std::vector<VariableIndex> batch_ids, int aid);
+  void accumulate_parameter_gradients(const std::vector<Tensor>& batched_ndEdfs);
+  void arrange_batches(VariableIndex first_batch, VariableIndex end_batch, std::vector<std::vector<VariableIndex> >& groups);
+  float* contiguous_gradients(const BatchInfo& my_batch, size_t ai, const std::vector<Tensor>& batched_ndEdfs) const;
+  void recycle_batch_inputs(VariableIndex bid, VariableIndex first_node, VariableIndex first_batch, std::vector<unsigned>& batch_uses);
   const Tensor& get_nfx(VariableIndex i);
   std::vector<Tensor> nfx_cache;
   std::vector<Tensor> ndEdfs;
@@ -1,6 +1,7 @@
 #include "dynet/globals.h"
 #include "dynet/devices.h"
 #include "dynet/timing.h"
+#include "dynet/profiler.h"
 
 namespace dynet {
 
@@ -10,6 +11,11 @@ Device* default_device = nullptr;
 float weight_decay_lambda;
 int autobatch_flag; 
 int autobatch_debug_flag = 0;
+int exec_threads_flag = 1;
+bool inference_flag = false;
+std::atomic<bool> profiling_flag(false);
+int mem_log_flag = 0;
 NamedTimer timer;
+Profiler profiler;
 
 }
@@ -8,11 +8,14 @@ namespace dynet {
 
 class Device;
 class NamedTimer;
+class Profiler;
 
 extern std::mt19937* rndeng;
 extern std::vector<Device*> devices;
 extern Device* default_device;
+extern int mem_log_flag; // memory use is logged every mem_log_flag graphs, if positive
 extern NamedTimer timer; // debug timing in executors.
+extern Profiler profiler; // profiling of the execution of nodes
 
 } // namespace dynet
 
@@ -0,0 +1,3 @@
+// This is a dummy file that contains the same content as nodes-fused.cc but compiled
+// on CUDA
+#include "nodes-fused.cc"
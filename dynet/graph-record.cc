@@ -0,0 +1,256 @@
+#include "dynet/graph-record.h"
+
+#include <limits>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include "dynet/nodes.h"
+#include "dynet/param-nodes.h"
+#include "dynet/globals.h"
+#include "dynet/except.h"
+
+using namespace std;
+
+namespace dynet {
+
+using namespace expr;
+
+static const string RECORDED_GRAPH_HEADER = "dynet-graph";
+static const int RECORDED_GRAPH_VERSION = 1;
+
+RecordedGraph record_graph(const ComputationGraph& cg) {
+  RecordedGraph g;
+  unordered_map<const void*, int> param_ids;
+  auto add_param = [&](const void* storage, bool lookup, const Dim& dim, unsigned size) {
+    auto it = param_ids.find(storage);
+    if (it != param_ids.end()) return it->second;
+    RecordedParameter p;
+    p.lookup = lookup;
+    p.dim = dim;
+    p.size = size;
+    g.params.push_back(p);
+    return param_ids[storage] = g.params.size() - 1;
+  };
+  auto record_param = [&](const Parameter& p, const LookupParameter& lp) {
+    if (p.mp != nullptr)
+      return add_param(p.get(), false, p.get()->dim, 0);
+    DYNET_ARG_CHECK(lp.mp != nullptr, "Parameter node without a parameter in record_graph");
+    return add_param(lp.get(), true, lp.get()->dim, lp.get()->values.size());
+  };
+  g.nodes.resize(cg.nodes.size());
+  for (size_t i = 0; i < cg.nodes.size(); ++i) {
+    const Node* node = cg.nodes[i];
+    RecordedNode & n = g.nodes[i];
+    n.type = node->type_name();
+    n.args.assign(node->args.begin(), node->args.end());
+    n.dim = node->dim;
+    n.param = -1;
+    if (auto pn = dynamic_cast<const ParameterNode*>(node)) {
+      n.param = record_param(pn->params, pn->lparams);
+    } else if (auto cpn = dynamic_cast<const ConstParameterNode*>(node)) {
+      n.param = record_param(cpn->params, cpn->lparams);
+    } else if (auto ln = dynamic_cast<const LookupNode*>(node)) {
+      n.param = record_param(Parameter(), ln->params);
+    } else if (auto pr = dynamic_cast<const PickRange*>(node)) {
+      n.attrs = {pr->start, pr->end, pr->dim};
+    } else if (auto c = dynamic_cast<const Concatenate*>(node)) {
+      n.attrs = {c->dimension};
+    } else if (auto t = dynamic_cast<const Transpose*>(node)) {
+      n.attrs = t->dims;
+    } else if (auto cp = dynamic_cast<const ConstantPlusX*>(node)) {
+      n.values = {cp->c};
+    } else if (auto cm = dynamic_cast<const ConstantMinusX*>(node)) {
+      n.values = {cm->c};
+    } else if (auto sm = dynamic_cast<const ConstScalarMultiply*>(node)) {
+      n.values = {sm->alpha};
+    }
+  }
+  return g;
+}
+
+static void save_dim(ostream& os, const Dim& d) {
+  os << d.nd;
+  for (unsigned i = 0; i < d.nd; ++i)
+    os << ' ' << d.d[i];
+  os << ' ' << d.bd;
+}
+
+static Dim load_dim(istream& is) {
+  unsigned nd, bd;
+  is >> nd;
+  DYNET_ARG_CHECK(is && nd <= DYNET_MAX_TENSOR_DIM, "Bad dimensions in recorded graph");
+  vector<long> d(nd);
+  for (auto & di : d) is >> di;
+  is >> bd;
+  return Dim(d, bd);
+}
+
+void save_recorded_graph(ostream& os, const RecordedGraph& g) {
+  const streamsize precision = os.precision(numeric_limits<float>::max_digits10);
+  os << RECORDED_GRAPH_HEADER << ' ' << RECORDED_GRAPH_VERSION << '\n';
+  os << "params " << g.params.size() << '\n';
+  for (auto & p : g.params) {
+    os << (p.lookup ? 'l' : 'p') << ' ' << p.size << ' ';
+    save_dim(os, p.dim);
+    os << '\n';
+  }
+  os << "nodes " << g.nodes.size() << '\n';
+  for (auto & n : g.nodes) {
+    os << n.type << ' ' << n.param << ' ' << n.args.size();
+    for (auto a : n.args) os << ' ' << a;
+    os << ' ' << n.attrs.size();
+    for (auto a : n.attrs) os << ' ' << a;
+    os << ' ' << n.values.size();
+    for (auto v : n.values) os << ' ' << v;
+    os << ' ';
+    save_dim(os, n.dim);
+    os << '\n';
+  }
+  os.precision(precision);
+}
+
+RecordedGraph load_recorded_graph(istream& is) {
+  RecordedGraph g;
+  string header, word;
+  int version;
+  size_t n;
+  is >> header >> version;
+  if (!is || header != RECORDED_GRAPH_HEADER)
+    DYNET_INVALID_ARG("Not a recorded graph");
+  if (version != RECORDED_GRAPH_VERSION)
+    DYNET_INVALID_ARG("Unsupported version of recorded graph: " << version);
+  is >> word >> n;
+  DYNET_ARG_CHECK(is && word == "params", "Bad parameter list in recorded graph");
+  g.params.resize(n);
+  for (auto & p : g.params) {
+    char kind;
+    is >> kind >> p.size;
+    p.lookup = (kind == 'l');
+    p.dim = load_dim(is);
+  }
+  is >> word >> n;
+  DYNET_ARG_CHECK(is && word == "nodes", "Bad node list in recorded graph");
+  g.nodes.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    RecordedNode & node = g.nodes[i];
+    size_t nargs, nattrs, nvalues;
+    is >> node.type >> node.param >> nargs;
+    node.args.resize(nargs);
+    for (auto & a : node.args) {
+      is >> a;
+      DYNET_ARG_CHECK(a < i, "Node " << i << " of recorded graph has a bad argument " << a);
+    }
+    is >> nattrs;
+    node.attrs.resize(nattrs);
+    for (auto & a : node.attrs) is >> a;
+    is >> nvalues;
+    node.values.resize(nvalues);
+    for (auto & v : node.values) is >> v;
+    node.dim = load_dim(is);
+    DYNET_ARG_CHECK(is, "Could not read node " << i << " of recorded graph");
+    DYNET_ARG_CHECK(node.param < (int)g.params.size(), "Node " << i << " of recorded graph has a bad parameter " << node.param);
+  }
+  return g;
+}
+
+GraphReplayer::GraphReplayer(const RecordedGraph& g) : g(g), stand_ins(0) {
+  params.resize(g.params.size());
+  lookup_params.resize(g.params.size());
+  for (size_t i = 0; i < g.params.size(); ++i) {
+    if (g.params[i].lookup)
+      lookup_params[i] = model.add_lookup_parameters(g.params[i].size, g.params[i].dim);
+    else
+      params[i] = model.add_parameters(g.params[i].dim);
+  }
+}
+
+// builds the node n of a recorded graph from its arguments a, or returns
+// false if nodes of its type cannot be rebuilt
+static bool replay_node(ComputationGraph& cg, const RecordedNode& n, const vector<VariableIndex>& a, VariableIndex& i) {
+  const string& t = n.type;
+  const size_t arity = a.size();
+  if (arity == 1) {
+    if (t == "Tanh") i = cg.add_function<Tanh>({a[0]});
+    else if (t == "LogisticSigmoid") i = cg.add_function<LogisticSigmoid>({a[0]});
+    else if (t == "Rectify") i = cg.add_function<Rectify>({a[0]});
+    else if (t == "SoftSign") i = cg.add_function<SoftSign>({a[0]});
+    else if (t == "Exp") i = cg.add_function<Exp>({a[0]});
+    else if (t == "Log") i = cg.add_function<Log>({a[0]});
+    else if (t == "Negate") i = cg.add_function<Negate>({a[0]});
+    else if (t == "Square") i = cg.add_function<Square>({a[0]});
+    else if (t == "Cube") i = cg.add_function<Cube>({a[0]});
+    else if (t == "Sqrt") i = cg.add_function<Sqrt>({a[0]});
+    else if (t == "Abs") i = cg.add_function<Abs>({a[0]});
+    else if (t == "Erf") i = cg.add_function<Erf>({a[0]});
+    else if (t == "Identity") i = cg.add_function<Identity>({a[0]});
+    else if (t == "Softmax") i = cg.add_function<Softmax>({a[0]});
+    else if (t == "LogSoftmax") i = cg.add_function<LogSoftmax>({a[0]});
+    else if (t == "SquaredNorm") i = cg.add_function<SquaredNorm>({a[0]});
+    else if (t == "SumElements") i = cg.add_function<SumElements>({a[0]});
+    else if (t == "SumBatches") i = cg.add_function<SumBatches>({a[0]});
+    else if (t == "Reshape") i = cg.add_function<Reshape>({a[0]}, n.dim);
+    else if (t == "Transpose") i = cg.add_function<Transpose>({a[0]}, n.attrs);
+    else if (t == "ConstantPlusX" && n.values.size() == 1) i = cg.add_function<ConstantPlusX>({a[0]}, n.values[0]);
+    else if (t == "ConstantMinusX" && n.values.size() == 1) i = cg.add_function<ConstantMinusX>({a[0]}, n.values[0]);
+    else if (t == "ConstScalarMultiply" && n.values.size() == 1) i = cg.add_function<ConstScalarMultiply>({a[0]}, n.values[0]);
+    else if (t == "PickRange" && n.attrs.size() == 3) i = cg.add_function<PickRange>({a[0]}, n.attrs[0], n.attrs[1], n.attrs[2]);
+    else if (t == "Sum") i = cg.add_function<Sum>(a);
+    else if (t == "Concatenate" && n.attrs.size() == 1) i = cg.add_function<Concatenate>(a, n.attrs[0]);
+    else return false;
+  } else if (arity == 2) {
+    if (t == "MatrixMultiply") i = cg.add_function<MatrixMultiply>({a[0], a[1]});
+    else if (t == "CwiseMultiply") i = cg.add_function<CwiseMultiply>({a[0], a[1]});
+    else if (t == "CwiseQuotient") i = cg.add_function<CwiseQuotient>({a[0], a[1]});
+    else if (t == "Sum") i = cg.add_function<Sum>(a);
+    else if (t == "Concatenate" && n.attrs.size() == 1) i = cg.add_function<Concatenate>(a, n.attrs[0]);
+    else return false;
+  } else if (arity > 2) {
+    if (t == "Sum") i = cg.add_function<Sum>(a);
+    else if (t == "AffineTransform") i = cg.add_function<AffineTransform>(a);
+    else if (t == "Concatenate" && n.attrs.size() == 1) i = cg.add_function<Concatenate>(a, n.attrs[0]);
+    else return false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+Expression GraphReplayer::build(ComputationGraph& cg) {
+  DYNET_ARG_CHECK(g.nodes.size() > 0, "Cannot replay an empty graph");
+  stand_ins = 0;
+  normal_distribution<float> normal(0.f, 1.f);
+  vector<VariableIndex> ids(g.nodes.size()), a;
+  for (size_t k = 0; k < g.nodes.size(); ++k) {
+    const RecordedNode & n = g.nodes[k];
+    a.clear();
+    for (auto arg : n.args) a.push_back(ids[arg]);
+    VariableIndex i;
+    if (n.param >= 0 && g.params[n.param].lookup && n.type == "LookupNode") {
+      vector<unsigned> indices(n.dim.bd);
+      for (auto & index : indices) index = rand0n(g.params[n.param].size);
+      i = (n.dim.bd == 1 ? lookup(cg, lookup_params[n.param], indices[0]) : lookup(cg, lookup_params[n.param], indices)).i;
+    } else if (n.param >= 0) {
+      const bool is_const = (n.type == "ConstParameterNode");
+      if (g.params[n.param].lookup)
+        i = (is_const ? const_parameter(cg, lookup_params[n.param]) : parameter(cg, lookup_params[n.param])).i;
+      else
+        i = (is_const ? const_parameter(cg, params[n.param]) : parameter(cg, params[n.param])).i;
+    } else if (!replay_node(cg, n, a, i)) {
+      // inputs, and nodes that cannot be rebuilt, are replaced by random
+      // inputs of the same dimensions
+      vector<float> values(n.dim.size());
+      for (auto & v : values) v = normal(*rndeng);
+      i = input(cg, n.dim, values).i;
+      if (n.type != "InputNode" && n.type != "ScalarInputNode")
+        ++stand_ins;
+    }
+    ids[k] = i;
+  }
+  Expression last(&cg, ids.back());
+  if (g.nodes.back().dim.size() == 1)
+    return last;
+  return sum_batches(squared_norm(last));
+}
+
+} // namespace dynet
@@ -0,0 +1,81 @@
+#ifndef DYNET_GRAPH_RECORD_H
+#define DYNET_GRAPH_RECORD_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dynet/dynet.h"
+#include "dynet/model.h"
+#include "dynet/expr.h"
+
+namespace dynet {
+
+/**
+ * \brief A node of a recorded graph
+ */
+struct RecordedNode {
+  std::string type; /**< Name of the class of the node, see Node::type_name() */
+  std::vector<unsigned> args; /**< Indices of the arguments */
+  Dim dim; /**< Dimensions of the output */
+  int param; /**< Index of the parameter the node reads in RecordedGraph::params, or -1 */
+  std::vector<unsigned> attrs; /**< Settings needed to rebuild the node, like the range of a PickRange */
+  std::vector<float> values; /**< Real valued settings, like the constant of a ConstantPlusX */
+};
+
+/**
+ * \brief A parameter read by a recorded graph
+ */
+struct RecordedParameter {
+  bool lookup; /**< Whether this is a lookup parameter */
+  Dim dim; /**< Dimensions of the parameter, or of one entry of a lookup parameter */
+  unsigned size; /**< Number of entries of a lookup parameter */
+};
+
+/**
+ * \brief The structure of a computation graph, without its data
+ * \details Graphs are recorded with record_graph(), and saved to and loaded
+ *          from a text format with save_recorded_graph() and
+ *          load_recorded_graph(). GraphReplayer rebuilds them with random
+ *          data, so real workloads can be benchmarked offline (see
+ *          examples/cpp/graph-replay).
+ */
+struct RecordedGraph {
+  std::vector<RecordedParameter> params;
+  std::vector<RecordedNode> nodes;
+};
+
+RecordedGraph record_graph(const ComputationGraph& cg);
+void save_recorded_graph(std::ostream& os, const RecordedGraph& g);
+RecordedGraph load_recorded_graph(std::istream& is);
+
+/**
+ * \brief Rebuilds recorded graphs with random data
+ * \details The parameters of the graph are created in a synthetic model,
+ *          inputs are filled with random values and lookups read random
+ *          entries. Nodes whose type cannot be rebuilt are replaced by inputs
+ *          of the same dimensions, so the graph around them is kept.
+ */
+class GraphReplayer {
+ public:
+  explicit GraphReplayer(const RecordedGraph& g);
+  /**
+   * \brief Adds the nodes of the recorded graph to cg
+   * \return A scalar loss that depends on the last node
+   */
+  expr::Expression build(ComputationGraph& cg);
+  /**
+   * \brief Number of nodes replaced by inputs in the last graph built
+   */
+  unsigned num_stand_ins() const { return stand_ins; }
+  Model model;
+ private:
+  RecordedGraph g;
+  std::vector<Parameter> params;
+  std::vector<LookupParameter> lookup_params;
+  unsigned stand_ins;
+};
+
+} // namespace dynet
+
+#endif
@@ -1,34 +1,200 @@
 #include "dynet/graph.h"
 #include "dynet/dynet.h"
 #include <vector>
+#include <algorithm>
+#include <typeinfo>
+#include <unordered_map>
+#include <boost/functional/hash.hpp>
 #include "dynet/dynet-helper.h"
+#include "dynet/devices.h"
+#include "dynet/exec.h"
+#include "dynet/nodes.h"
+#include "dynet/nodes-fused.h"
+#include "dynet/param-nodes.h"
+#include "dynet/except.h"
 
 using namespace std;
 
 namespace dynet {
 
-void graph_optimize(ComputationGraph* cg) {
-  // topo sort
+// If node i is an elementwise operation whose inputs all have its dimensions,
+// describe it as a step of a FusedElementwise program (operands unset)
+static bool fusable_op(const ComputationGraph& cg, VariableIndex i, FusedElementwise::Op& op) {
+  const Node* node = cg.nodes[i];
+  if (node->device == nullptr || node->device->type != DeviceType::CPU || node->arity() == 0)
+    return false;
+  for (VariableIndex arg : node->args)
+    if (cg.nodes[arg]->dim != node->dim)
+      return false;
+  op.c = 0.f;
+  if (dynamic_cast<const Tanh*>(node)) op.type = nt::tanh;
+  else if (dynamic_cast<const Sqrt*>(node)) op.type = nt::sqrt;
+  else if (dynamic_cast<const Abs*>(node)) op.type = nt::abs;
+  else if (dynamic_cast<const Erf*>(node)) op.type = nt::erf;
+  else if (dynamic_cast<const Square*>(node)) op.type = nt::square;
+  else if (dynamic_cast<const Cube*>(node)) op.type = nt::cube;
+  else if (dynamic_cast<const Exp*>(node)) op.type = nt::exp;
+  else if (dynamic_cast<const Log*>(node)) op.type = nt::log;
+  else if (dynamic_cast<const Negate*>(node)) op.type = nt::negate;
+  else if (dynamic_cast<const Rectify*>(node)) op.type = nt::rectify;
+  else if (dynamic_cast<const LogisticSigmoid*>(node)) op.type = nt::logistic;
+  else if (dynamic_cast<const SoftSign*>(node)) op.type = nt::softsign;
+  else if (dynamic_cast<const Identity*>(node)) op.type = nt::identity;
+  else if (auto n = dynamic_cast<const ConstantPlusX*>(node)) { op.type = nt::plus_const; op.c = n->c; }
+  else if (auto n = dynamic_cast<const ConstScalarMultiply*>(node)) { op.type = nt::scalar_mult; op.c = n->alpha; }
+  else if (dynamic_cast<const CwiseMultiply*>(node)) op.type = nt::cmult;
+  else if (dynamic_cast<const Sum*>(node)) op.type = nt::sum;
+  else return false;
+  return true;
+}
+
+// replaces node i by a FusedAway node, which has no value
+static void remove_node(ComputationGraph* cg, VariableIndex i) {
+  Node* node = cg->nodes[i];
+  Node* away = cg->new_node<FusedAway>();
+  away->dim = node->dim;
+  away->device = node->device;
+  away->set_cg(cg);
+  cg->delete_node(node);
+  cg->nodes[i] = away;
+}
+
+// Replaces chains of elementwise nodes by FusedElementwise nodes. A node is
+// fused into the one consuming it if it is that node's only consumer, so
+// the values that disappear are never used outside of the fused chain.
+// Requested outputs count as one more use, so they are never fused away.
+static void fuse_elementwise(ComputationGraph* cg, const vector<VariableIndex>& outputs) {
   vector<Node*>& nodes = cg->nodes;
-  vector<int> longest_paths(nodes.size());
-  for (unsigned i = 0; i < nodes.size(); ++i) {
-    auto& v = *nodes[i];  // vertex v_i
-    auto& lp = longest_paths[i]; // distance to v_i
-    for (auto e : v.args) {
-      int weight = 0;
-      if (v.args.size() == 7) weight = 1;
-      int pte = longest_paths[e] + weight;
-      if (pte > lp) lp = pte;
+  const unsigned num_nodes = nodes.size();
+  vector<unsigned> uses(num_nodes, 0);
+  for (auto node : nodes)
+    for (VariableIndex arg : node->args)
+      ++uses[arg];
+  for (VariableIndex o : outputs)
+    ++uses[o];
+  vector<FusedElementwise::Op> ops(num_nodes);
+  vector<bool> fusable(num_nodes), fused(num_nodes, false);
+  for (unsigned i = 0; i < num_nodes; ++i)
+    fusable[i] = fusable_op(*cg, (VariableIndex)i, ops[i]);
+
+  vector<VariableIndex> group, stack;
+  for (int root = num_nodes - 1; root >= 0; --root) {
+    if (!fusable[root] || fused[root]) continue;
+    // collect the nodes whose only consumer is in the group
+    group.clear();
+    stack.assign(1, (VariableIndex)root);
+    while (!stack.empty()) {
+      VariableIndex i = stack.back(); stack.pop_back();
+      group.push_back(i);
+      for (VariableIndex arg : nodes[i]->args) {
+        if (fusable[arg] && !fused[arg] && uses[arg] == 1 && find(group.begin(), group.end(), arg) == group.end()) {
+          fused[arg] = true;
+          stack.push_back(arg);
+        }
+      }
     }
+    if (group.size() < 2) continue;
+    sort(group.begin(), group.end());
+
+    // build the program in topological order, the results of the steps
+    // are numbered after the inputs
+    vector<VariableIndex> inputs;
+    for (VariableIndex i : group)
+      for (VariableIndex arg : nodes[i]->args)
+        if (!binary_search(group.begin(), group.end(), arg) && find(inputs.begin(), inputs.end(), arg) == inputs.end())
+          inputs.push_back(arg);
+    vector<FusedElementwise::Op> program;
+    for (VariableIndex i : group) {
+      FusedElementwise::Op op = ops[i];
+      for (VariableIndex arg : nodes[i]->args) {
+        auto it = lower_bound(group.begin(), group.end(), arg);
+        if (it != group.end() && *it == arg)
+          op.operands.push_back(inputs.size() + (it - group.begin()));
+        else
+          op.operands.push_back(find(inputs.begin(), inputs.end(), arg) - inputs.begin());
+      }
+      program.push_back(op);
+    }
+
+    Node* fused_node = cg->new_node<FusedElementwise>(inputs, program);
+    fused_node->dim = nodes[root]->dim;
+    fused_node->device = nodes[root]->device;
+    fused_node->set_cg(cg);
+    cg->delete_node(nodes[root]);
+    nodes[root] = fused_node;
+    for (size_t s = 0; s + 1 < group.size(); ++s)
+      remove_node(cg, group[s]);
   }
+}
+
+// whether nodes a and b, which have the same arguments, compute the same
+// value. Only nodes that compare all their side information in cse_equal()
+// are ever merged.
+static bool same_operation(const Node* a, const Node* b) {
+  return typeid(*a) == typeid(*b) && a->dim == b->dim && a->cse_equal(*b);
+}
+
+// Merges nodes that compute the same operation on the same arguments, and
+// parameter nodes that read the same parameter: the consumers of a
+// duplicate read the first of the identical nodes instead. The duplicates
+// keep their values, but are not used by any node anymore.
+static void eliminate_common_subexpressions(ComputationGraph* cg) {
+  vector<Node*>& nodes = cg->nodes;
+  vector<VariableIndex> representative(nodes.size());
+  unordered_map<size_t, vector<VariableIndex> > candidates;
   for (unsigned i = 0; i < nodes.size(); ++i) {
-    vector<string> x;
-    for (auto e : nodes[i]->args) {
-      x.push_back(string("x") + to_string(e));
+    Node* node = nodes[i];
+    representative[i] = (VariableIndex)i;
+    size_t h = typeid(*node).hash_code();
+    for (auto & arg : node->args) {
+      arg = representative[arg];
+      boost::hash_combine(h, (unsigned)arg);
+    }
+    if (!node->has_value())
+      continue;
+    auto & same_hash = candidates[h];
+    for (VariableIndex j : same_hash) {
+      const Node* other = nodes[j];
+      if (other->arity() == node->arity() && equal(node->args.begin(), node->args.end(), other->args.begin()) && same_operation(node, other)) {
+        representative[i] = j;
+        break;
+      }
     }
-    cerr << "LONGEST PATH: " << longest_paths[i] << "\tx" << i << " = " << nodes[i]->as_string(x) << endl;
+    if (representative[i] == (VariableIndex)i)
+      same_hash.push_back((VariableIndex)i);
+  }
+}
+
+// Removes the nodes that none of the outputs depend on
+static void remove_dead_nodes(ComputationGraph* cg, const vector<VariableIndex>& outputs) {
+  vector<Node*>& nodes = cg->nodes;
+  vector<bool> needed(nodes.size(), false);
+  for (VariableIndex i : outputs) {
+    DYNET_ARG_CHECK(i < nodes.size(), "Output " << i << " is not a node of the graph in graph_optimize()");
+    needed[i] = true;
   }
-  throw std::runtime_error("Failure in graph optimization");// DEBUGGING
+  for (unsigned i = nodes.size(); i-- > 0; )
+    if (needed[i])
+      for (VariableIndex arg : nodes[i]->args)
+        needed[arg] = true;
+  for (unsigned i = 0; i < nodes.size(); ++i)
+    if (!needed[i] && nodes[i]->has_value())
+      remove_node(cg, (VariableIndex)i);
+  auto & params = cg->parameter_nodes;
+  params.erase(remove_if(params.begin(), params.end(), [&](VariableIndex i) { return !needed[i]; }), params.end());
+}
+
+void graph_optimize(ComputationGraph* cg) {
+  eliminate_common_subexpressions(cg);
+  fuse_elementwise(cg, vector<VariableIndex>());
+  cg->invalidate();
+}
+
+void graph_optimize(ComputationGraph* cg, const vector<VariableIndex>& outputs) {
+  eliminate_common_subexpressions(cg);
+  remove_dead_nodes(cg, outputs);
+  fuse_elementwise(cg, outputs);
+  cg->invalidate();
 }
 
-} // namespaiice dynet
+} // namespace dynet
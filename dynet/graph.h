@@ -1,9 +1,42 @@
 #ifndef DYNET_GRAPH_H
 #define DYNET_GRAPH_H
 
+#include <vector>
+
+#include "dynet/dynet.h"
+
 namespace dynet {
-struct ComputationGraph;
+
+/**
+ * \brief Rewrite a ComputationGraph into one that is cheaper to execute
+ * \details Nodes that compute the same operation on the same arguments,
+ *          like parameter nodes of the same parameter or transposes of the
+ *          same matrix, are merged: their consumers all read the first of
+ *          them. Chains of elementwise operations (tanh, logistic, cmult, sums
+ *          and the like) over inputs of the same dimensions are then fused
+ *          into single nodes, which evaluate them over blocks of elements that
+ *          stay in cache (see examples/cpp/elementwise-fusion for timings).
+ *          Call this after building the graph and before the forward pass.
+ *          The values of nodes that were fused into their only consumer are
+ *          not computed anymore, so do not request them with get_value().
+ *
+ * \param cg The graph to optimize
+ */
 void graph_optimize(ComputationGraph* cg);
+/**
+ * \brief Rewrite a ComputationGraph into one that is cheaper to execute,
+ *        given the nodes whose values are needed
+ * \details Like graph_optimize(ComputationGraph*), and also removes the
+ *          nodes that none of the outputs depend on, including the merged
+ *          duplicates. Removed nodes keep their index, but are not computed
+ *          and take no memory. Only the values of the outputs, and of the
+ *          nodes they depend on that were not merged or fused, can be
+ *          requested afterwards.
+ *
+ * \param cg The graph to optimize
+ * \param outputs Indices of the nodes whose values are needed
+ */
+void graph_optimize(ComputationGraph* cg, const std::vector<VariableIndex>& outputs);
 } // namespace dynet
 
 #endif
@@ -3,6 +3,8 @@
 #include "dynet/dynet.h"
 #include "dynet/weight-decay.h"
 #include "dynet/globals.h"
+#include "dynet/profiler.h"
+#include "dynet/mem-stats.h"
 
 #include <iostream>
 #include <random>
@@ -17,8 +19,8 @@ using namespace std;
 
 namespace dynet {
 
-DynetParams::DynetParams() : random_seed(0), mem_descriptor("512"), weight_decay(0), autobatch(0), autobatch_debug(0),
-  shared_parameters(false)
+DynetParams::DynetParams() : random_seed(0), mem_descriptor("512"), weight_decay(0), autobatch(0), autobatch_debug(0), exec_threads(1), inference(false),
+  hugepages(0), numa_node(-1), numa_interleave(false), first_touch(false), mem_log(0), mem_recommend(false), shared_parameters(false)
 #if HAVE_CUDA
   , ngpus_requested(false), ids_requested(false), requested_gpus(-1)
 #endif
@@ -32,6 +34,11 @@ DynetParams::~DynetParams()
 {
 }
 
+// where the profile is saved at cleanup, if profiling was requested
+static string profiling_prefix;
+// whether a memory descriptor is recommended at cleanup
+static bool mem_recommend = false;
+
 static void remove_args(int& argc, char**& argv, int& argi, int n) {
   for (int i = argi + n; i < argc; ++i)
     argv[i - n] = argv[i];
@@ -99,6 +106,68 @@ DynetParams extract_dynet_params(int& argc, char**& argv, bool shared_parameters
       params.autobatch_debug = 1;
         remove_args(argc, argv, argi, 1);
     }
+    else if (arg == "--dynet-exec-threads" || arg == "--dynet_exec_threads") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-exec-threads expects an argument (number of threads)");
+      } else {
+        string a2 = argv[argi + 1];
+        istringstream c(a2); c >> params.exec_threads;
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+    else if (arg == "--dynet-inference" || arg == "--dynet_inference") {
+      params.inference = true;
+      remove_args(argc, argv, argi, 1);
+    }
+    else if (arg == "--dynet-profiling" || arg == "--dynet_profiling") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-profiling expects an argument (prefix of the profile files)");
+      } else {
+        params.profiling = argv[argi + 1];
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+
+    // CPU memory
+    else if (arg == "--dynet-hugepages" || arg == "--dynet_hugepages") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-hugepages expects an argument (0 for none, 1 for transparent, 2 for explicit huge pages)");
+      } else {
+        string a2 = argv[argi + 1];
+        istringstream c(a2); c >> params.hugepages;
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+    else if (arg == "--dynet-numa-node" || arg == "--dynet_numa_node") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-numa-node expects an argument (the NUMA node to bind the memory to)");
+      } else {
+        string a2 = argv[argi + 1];
+        istringstream c(a2); c >> params.numa_node;
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+    else if (arg == "--dynet-numa-interleave" || arg == "--dynet_numa_interleave") {
+      params.numa_interleave = true;
+      remove_args(argc, argv, argi, 1);
+    }
+    else if (arg == "--dynet-first-touch" || arg == "--dynet_first_touch") {
+      params.first_touch = true;
+      remove_args(argc, argv, argi, 1);
+    }
+    else if (arg == "--dynet-mem-log" || arg == "--dynet_mem_log") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-mem-log expects an argument (the number of graphs between logs)");
+      } else {
+        string a2 = argv[argi + 1];
+        istringstream c(a2); c >> params.mem_log;
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+    else if (arg == "--dynet-mem-recommend" || arg == "--dynet_mem_recommend") {
+      params.mem_recommend = true;
+      remove_args(argc, argv, argi, 1);
+    }
 
 #if HAVE_CUDA
     // Number of GPUs
@@ -200,8 +269,57 @@ void initialize(DynetParams& params) {
     cerr << "[dynet] using autobatching debugging" << endl;
   autobatch_debug_flag = params.autobatch_debug;
 
+  // Set parallel execution
+  if (params.exec_threads < 1)
+    throw std::invalid_argument("[dynet] number of execution threads must be at least 1\n");
+  if (params.exec_threads > 1)
+    cerr << "[dynet] executing independent nodes on " << params.exec_threads << " threads" << endl;
+  exec_threads_flag = params.exec_threads;
+
+  // Set inference only mode
+  if (params.inference)
+    cerr << "[dynet] using inference mode, no backward memory is reserved" << endl;
+  inference_flag = params.inference;
+
+  // Set profiling
+  profiling_prefix = params.profiling;
+  if (!profiling_prefix.empty()) {
+    cerr << "[dynet] profiling, the profile is saved to " << profiling_prefix << ".trace.json and " << profiling_prefix << ".summary.tsv at cleanup" << endl;
+    profiler.start();
+  }
+
+  // Set the placement of CPU memory
+  if (params.hugepages < 0 || params.hugepages > 2)
+    throw std::invalid_argument("[dynet] huge pages must be 0 (none), 1 (transparent) or 2 (explicit)\n");
+  if (params.numa_node >= 0 && params.numa_interleave)
+    throw std::invalid_argument("[dynet] CPU memory cannot be both bound to a NUMA node and interleaved\n");
+  CPUMemoryOptions cpu_mem_opts;
+  cpu_mem_opts.hugepages = params.hugepages;
+  cpu_mem_opts.numa_node = params.numa_node;
+  cpu_mem_opts.numa_interleave = params.numa_interleave;
+  cpu_mem_opts.first_touch = params.first_touch;
+  if (params.hugepages)
+    cerr << "[dynet] using " << (params.hugepages == 1 ? "transparent" : "explicit") << " huge pages for CPU memory" << endl;
+  if (params.numa_node >= 0)
+    cerr << "[dynet] binding CPU memory to NUMA node " << params.numa_node << endl;
+  if (params.numa_interleave)
+    cerr << "[dynet] interleaving CPU memory over NUMA nodes" << endl;
+  if (params.first_touch)
+    cerr << "[dynet] CPU memory is placed by the threads that first use it" << endl;
+
+  // Set memory telemetry
+  if (params.mem_log < 0)
+    throw std::invalid_argument("[dynet] the number of graphs between memory logs must not be negative\n");
+  if (params.mem_log > 0)
+    cerr << "[dynet] logging the use of memory every " << params.mem_log << " graphs" << endl;
+  mem_log_flag = params.mem_log;
+  mem_recommend = params.mem_recommend;
+
   // Allocate memory
   cerr << "[dynet] allocating memory: " << params.mem_descriptor << "MB\n";
+  DeviceMempoolSizes mem_sizes(params.mem_descriptor);
+  if (params.inference)
+    mem_sizes.used[(int)DeviceMempool::DEDFS] = 0;
   // TODO: Once multi-device support is added, we will potentially allocate both CPU
   //       and GPU, not either-or
   int default_index = 0;
@@ -209,7 +327,7 @@ void initialize(DynetParams& params) {
     for (auto gpu : gpudevices)
       devices.push_back(gpu);
   } else {
-    devices.push_back(new Device_CPU(devices.size(), params.mem_descriptor, params.shared_parameters));
+    devices.push_back(new Device_CPU(devices.size(), mem_sizes, params.shared_parameters, cpu_mem_opts));
   }
   default_device = devices[default_index];
 
@@ -227,6 +345,12 @@ void initialize(int& argc, char**& argv, bool shared_parameters) {
 }
 
 void cleanup() {
+  if (mem_recommend && default_device != nullptr)
+    cerr << "[dynet] recommended memory: --dynet-mem " << recommend_mem_descriptor() << endl;
+  if (!profiling_prefix.empty()) {
+    profiler.stop();
+    profiler.save(profiling_prefix);
+  }
   delete rndeng;
   // TODO: Devices cannot be deleted at the moment
   // for(Device* device : devices) delete device;
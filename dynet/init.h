@@ -9,6 +9,8 @@ namespace dynet {
 extern float weight_decay_lambda;
 extern int autobatch_flag;
 extern int autobatch_debug_flag;
+extern int exec_threads_flag;
+extern bool inference_flag;
 
 /**
  * \brief Represents general parameters for dynet
@@ -22,6 +24,15 @@ struct DynetParams {
   float weight_decay; /**< Weight decay rate for L2 regularization */
   int autobatch; /**< Whether to autobatch or not */
   int autobatch_debug; /**< Whether to show autobatch debug info or not */
+  int exec_threads; /**< Number of threads used to execute independent nodes in parallel */
+  bool inference; /**< Whether graphs are only used for inference, in which case no backward memory is reserved */
+  std::string profiling; /**< Prefix of the files the profile is saved to at cleanup, or empty for no profiling */
+  int hugepages; /**< Huge pages for the CPU memory: 0 for none, 1 for transparent huge pages, 2 for explicit huge pages */
+  int numa_node; /**< NUMA node the CPU memory is bound to, or -1 for the default placement */
+  bool numa_interleave; /**< Whether the CPU memory is interleaved over all NUMA nodes */
+  bool first_touch; /**< Whether the CPU memory is placed by the threads that first use it, instead of being zeroed at allocation */
+  int mem_log; /**< Log the use of the memory pools every mem_log graphs, or never if 0 */
+  bool mem_recommend; /**< Whether to recommend a --dynet-mem descriptor from the peak use of the memory at cleanup */
   bool shared_parameters; /**< TO DOCUMENT */
   bool ngpus_requested; /**< GPUs requested by number */
   bool ids_requested; /**< GPUs requested by ids */
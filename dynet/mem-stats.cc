@@ -0,0 +1,77 @@
+#include "dynet/mem-stats.h"
+
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "dynet/dynet.h"
+#include "dynet/devices.h"
+#include "dynet/globals.h"
+
+using namespace std;
+
+namespace dynet {
+
+static const char* pool_names[3] = {"forward", "backward", "parameters"};
+
+vector<DeviceMemoryUsage> memory_usage() {
+  vector<DeviceMemoryUsage> usage;
+  for (Device* device : devices) {
+    DeviceMemoryUsage u;
+    u.device = device;
+    for (int i = 0; i < 3; ++i) {
+      AlignedMemoryPool* pool = device->pool((DeviceMempool)i);
+      u.pools[i].used = pool->used();
+      u.pools[i].peak = pool->peak_used();
+      u.pools[i].capacity = pool->capacity();
+    }
+    usage.push_back(u);
+  }
+  return usage;
+}
+
+void reset_memory_peaks() {
+  for (Device* device : devices)
+    for (int i = 0; i < 3; ++i)
+      device->pool((DeviceMempool)i)->reset_peak();
+}
+
+map<string, size_t> memory_by_node_type(const ComputationGraph& cg) {
+  map<string, size_t> bytes;
+  for (const Node* node : cg.nodes) {
+    if (!node->has_value()) continue;
+    bytes[node->type_name()] += node->dim.size() * sizeof(float) + node->aux_storage_size();
+  }
+  return bytes;
+}
+
+string recommend_mem_descriptor(double margin) {
+  if (default_device == nullptr)
+    DYNET_RUNTIME_ERR("recommend_mem_descriptor() called before dynet::initialize()");
+  ostringstream oss;
+  for (int i = 0; i < 3; ++i) {
+    const double peak = default_device->pool((DeviceMempool)i)->peak_used() * (1 + margin);
+    oss << (i > 0 ? "," : "") << max(1.0, ceil(peak / (1 << 20)));
+  }
+  return oss.str();
+}
+
+void write_memory_usage(ostream& os) {
+  for (auto & u : memory_usage()) {
+    const Device* device = u.device;
+    for (int i = 0; i < 3; ++i) {
+      os << "[dynet] " << (device->type == DeviceType::CPU ? "CPU" : "GPU") << ' ' << device->device_id
+         << ' ' << pool_names[i] << " memory: used " << u.pools[i].used
+         << " peak " << u.pools[i].peak << " capacity " << u.pools[i].capacity << " bytes" << endl;
+    }
+  }
+}
+
+void count_graph_for_memory_log() {
+  static atomic<unsigned long> num_graphs(0);
+  if (mem_log_flag > 0 && ++num_graphs % mem_log_flag == 0)
+    write_memory_usage(cerr);
+}
+
+} // namespace dynet
@@ -0,0 +1,74 @@
+#ifndef DYNET_MEM_STATS_H
+#define DYNET_MEM_STATS_H
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace dynet {
+
+class Device;
+struct ComputationGraph;
+
+/**
+ * \brief Current and peak use of a memory pool, in bytes
+ */
+struct PoolUsage {
+  size_t used; /**< Bytes in use */
+  size_t peak; /**< Largest number of bytes in use since the last reset_memory_peaks() */
+  size_t capacity; /**< Bytes held by the pool */
+};
+
+/**
+ * \brief Use of the forward, backward and parameter memory of a device, indexed by DeviceMempool
+ */
+struct DeviceMemoryUsage {
+  const Device* device;
+  PoolUsage pools[3];
+};
+
+/**
+ * \ingroup compgraph
+ * \brief Gets the use of the memory pools of every device
+ * \details The forward and backward pools are those of the calling thread.
+ *          To measure a single graph, call reset_memory_peaks() before it is
+ *          built and memory_usage() after it is executed.
+ */
+std::vector<DeviceMemoryUsage> memory_usage();
+/**
+ * \ingroup compgraph
+ * \brief Restarts the peaks of the memory pools of the calling thread from their current use
+ */
+void reset_memory_peaks();
+/**
+ * \ingroup compgraph
+ * \brief Gets the forward memory that the values and auxiliary storage of
+ *        the nodes of a graph take, in bytes per type of node
+ */
+std::map<std::string, size_t> memory_by_node_type(const ComputationGraph& cg);
+/**
+ * \ingroup compgraph
+ * \brief Recommends a --dynet-mem descriptor FXS,DEDFS,PS from the peaks of
+ *        the pools of the default device
+ * \details Run a warm-up with the longest inputs expected first, so that the
+ *          peaks are representative. Each pool gets at least 1MB.
+ *
+ * \param margin Fraction of the peaks added to them
+ * \return The sizes of the pools in megabytes, separated by commas
+ */
+std::string recommend_mem_descriptor(double margin = 0.1);
+/**
+ * \ingroup compgraph
+ * \brief Writes the use of the memory pools of every device, one line per pool
+ */
+void write_memory_usage(std::ostream& os);
+/**
+ * \brief Counts a finished graph, and logs the memory use every
+ *        mem_log_flag graphs, as requested by --dynet-mem-log
+ */
+void count_graph_for_memory_log();
+
+} // namespace dynet
+
+#endif
@@ -1,12 +1,20 @@
 #include "dynet/mem.h"
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #if !_WINDOWS
 #include <sys/shm.h>
 #include <sys/mman.h>
 #endif
+#if __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include <fcntl.h>
 #if !_WINDOWS
@@ -26,6 +34,8 @@ namespace dynet {
 MemAllocator::~MemAllocator() {}
 
 void* CPUAllocator::malloc(size_t n) {
+  if (opts.mapped())
+    return map(n);
   void* ptr = _mm_malloc(n, align);
   if (!ptr) {
     cerr << "CPU memory allocation failed n=" << n << " align=" << align << endl;
@@ -35,9 +45,99 @@ void* CPUAllocator::malloc(size_t n) {
 }
 
 void CPUAllocator::free(void* mem) {
+  if (opts.mapped()) {
+#if !_WINDOWS
+    size_t n = 0;
+    {
+      lock_guard<mutex> lk(mapped_mutex);
+      auto it = mapped.find(mem);
+      if (it == mapped.end()) return;
+      n = it->second;
+      mapped.erase(it);
+    }
+    munmap(mem, n);
+#endif
+    return;
+  }
   _mm_free(mem);
 }
 
+#if __linux__
+// the NUMA nodes that are online, as listed in sysfs, e.g. "0-1,3"
+static vector<int> online_numa_nodes() {
+  vector<int> nodes;
+  ifstream in("/sys/devices/system/node/online");
+  string range;
+  while (getline(in, range, ',')) {
+    int first = 0, last = 0;
+    char dash = 0;
+    istringstream iss(range);
+    iss >> first;
+    if (iss >> dash >> last) {
+      for (int i = first; i <= last; ++i) nodes.push_back(i);
+    } else {
+      nodes.push_back(first);
+    }
+  }
+  if (nodes.empty()) nodes.push_back(0);
+  return nodes;
+}
+
+// sets the NUMA policy of memory that has not been touched yet
+static void bind_numa(void* ptr, size_t n, int node, bool interleave) {
+  const size_t bits = 8 * sizeof(unsigned long);
+  vector<unsigned long> mask(16);
+  vector<int> nodes = interleave ? online_numa_nodes() : vector<int>(1, node);
+  for (int i : nodes) {
+    if (i < 0 || (size_t)i >= mask.size() * bits)
+      DYNET_INVALID_ARG("NUMA node " << i << " is out of range");
+    mask[i / bits] |= 1ul << (i % bits);
+  }
+  const int mode = interleave ? MPOL_INTERLEAVE : MPOL_BIND;
+  if (syscall(SYS_mbind, ptr, n, mode, mask.data(), mask.size() * bits, 0) != 0)
+    cerr << "[dynet] could not set the NUMA policy of CPU memory: " << strerror(errno) << endl;
+}
+#endif
+
+// Maps fresh pages for the memory instead of taking it from the system
+// allocator, so that their size and placement can be chosen. The pages are
+// zero, and are only placed on a NUMA node when they are first written.
+void* CPUAllocator::map(size_t n) {
+#if _WINDOWS
+  cerr << "Huge pages, NUMA and first-touch memory options are not supported in Windows" << endl;
+  throw dynet::out_of_memory("CPU memory allocation failed");
+#else
+  void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (opts.hugepages == 2) {
+    const size_t huge_page = 2 << 20;
+    const size_t huge_n = (n + huge_page - 1) / huge_page * huge_page;
+    ptr = mmap(NULL, huge_n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) n = huge_n;
+  }
+#endif
+  // without reserved huge pages, fall back to transparent ones
+  if (ptr == MAP_FAILED) {
+    ptr = mmap(NULL, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+      cerr << "CPU memory allocation failed n=" << n << endl;
+      throw dynet::out_of_memory("CPU memory allocation failed");
+    }
+#ifdef MADV_HUGEPAGE
+    if (opts.hugepages != 0)
+      madvise(ptr, n, MADV_HUGEPAGE);
+#endif
+  }
+#if __linux__
+  if (opts.numa_node >= 0 || opts.numa_interleave)
+    bind_numa(ptr, n, opts.numa_node, opts.numa_interleave);
+#endif
+  lock_guard<mutex> lk(mapped_mutex);
+  mapped[ptr] = n;
+  return ptr;
+#endif
+}
+
 void CPUAllocator::zero(void* p, size_t n) {
   memset(p, 0, n);
 }
@@ -1,6 +1,9 @@
 #ifndef DYNET_MEM_H
 #define DYNET_MEM_H
 
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace dynet {
@@ -16,6 +19,9 @@ struct MemAllocator {
   virtual void* malloc(std::size_t n) = 0;
   virtual void free(void* mem) = 0;
   virtual void zero(void* p, std::size_t n) = 0;
+  // whether memory from malloc() is already zero, so that it need not be
+  // zeroed before its first use
+  virtual bool malloc_zeroes() const { return false; }
   inline std::size_t round_up_align(std::size_t n) const {
     if (align < 2) return n;
     return ((n + align - 1) / align) * align;
@@ -23,11 +29,29 @@ struct MemAllocator {
   const int align;
 };
 
+// how the CPU memory of the pools is obtained from the system
+struct CPUMemoryOptions {
+  CPUMemoryOptions() : hugepages(0), numa_node(-1), numa_interleave(false), first_touch(false) {}
+  // whether memory is mapped by the allocator itself rather than taken from
+  // the system allocator, which all the options require
+  bool mapped() const { return hugepages != 0 || numa_node >= 0 || numa_interleave || first_touch; }
+  int hugepages; // 0: none, 1: transparent huge pages, 2: explicit huge pages, or transparent ones if none are reserved
+  int numa_node; // NUMA node the memory is bound to, or -1
+  bool numa_interleave; // interleave the memory over all NUMA nodes
+  bool first_touch; // do not zero the memory when it is allocated, so its pages are placed by the threads that first use them
+};
+
 struct CPUAllocator : public MemAllocator {
-  CPUAllocator() : MemAllocator(32) {}
+  explicit CPUAllocator(const CPUMemoryOptions& opts = CPUMemoryOptions()) : MemAllocator(32), opts(opts) {}
   void* malloc(std::size_t n) override;
   void free(void* mem) override;
   void zero(void* p, std::size_t n) override;
+  bool malloc_zeroes() const override { return opts.first_touch; }
+  const CPUMemoryOptions opts;
+ private:
+  void* map(std::size_t n);
+  std::unordered_map<void*, std::size_t> mapped; // sizes of the mapped memory
+  std::mutex mapped_mutex;
 };
 
 struct SharedAllocator : public MemAllocator {
@@ -75,6 +75,17 @@ ParameterStorage::ParameterStorage(const Dim& d, const ParameterInit & init) : d
   init.initialize_params(values);
 }
 
+// gives the memory of a tensor back to the parameter pool of its device
+static void free_parameter_tensor(Tensor& t) {
+  if (t.device != nullptr && t.mem_pool == DeviceMempool::PS)
+    t.device->free_tensor(DeviceMempool::PS, t);
+}
+
+ParameterStorage::~ParameterStorage() {
+  free_parameter_tensor(values);
+  free_parameter_tensor(g);
+}
+
 size_t ParameterStorage::size() const { return dim.size(); }
 
 void ParameterStorage::zero() {
@@ -109,6 +120,7 @@ LookupParameterStorage::LookupParameterStorage(unsigned n, const Dim& d) : dim(d
   all_grads.device = all_values.device = default_device;
   default_device->allocate_tensor(DeviceMempool::PS, all_values);
   default_device->allocate_tensor(DeviceMempool::PS, all_grads);
+  TensorTools::zero(all_grads);
   ParameterInitGlorot init(true);
   init.initialize_params(all_values);
   initialize_lookups();
@@ -120,10 +132,16 @@ LookupParameterStorage::LookupParameterStorage(unsigned n, const Dim& d, const P
   all_grads.device = all_values.device = default_device;
   default_device->allocate_tensor(DeviceMempool::PS, all_values);
   default_device->allocate_tensor(DeviceMempool::PS, all_grads);
+  TensorTools::zero(all_grads);
   init.initialize_params(all_values);
   initialize_lookups();
 }
 
+LookupParameterStorage::~LookupParameterStorage() {
+  free_parameter_tensor(all_values);
+  free_parameter_tensor(all_grads);
+}
+
 void LookupParameterStorage::initialize_lookups() {
   int num = all_dim[all_dim.nd - 1];
   dim = all_dim; dim.nd--;
@@ -122,6 +122,8 @@ struct ParameterStorage : public ParameterStorageBase {
   Tensor values;/**< Values of the parameter */
   Tensor g;/**< Values of the gradient w.r.t. this parameter */
 
+  ~ParameterStorage() override;
+
 private:
   ParameterStorage() {}
   explicit ParameterStorage(const Dim& d, float minmax); // initialize with ~U(-minmax,+minmax)
@@ -217,6 +219,8 @@ struct LookupParameterStorage : public ParameterStorageBase {
   // gradients are sparse, so track which components are nonzero
   std::unordered_set<unsigned> non_zero_grads; /**< Gradients are sparse, so track which components are nonzero */
   bool all_updated; /** Whether all of the gradients have been updated. */
+
+  ~LookupParameterStorage() override;
 private:
   LookupParameterStorage() : all_updated(false) {}
   LookupParameterStorage(unsigned n, const Dim& d);
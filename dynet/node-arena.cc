@@ -0,0 +1,43 @@
+#include "dynet/node-arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace dynet {
+
+NodeArena::~NodeArena() {
+  for (auto & b : blocks)
+    free(b.mem);
+}
+
+void* NodeArena::allocate(size_t n, size_t align) {
+  while (current < blocks.size()) {
+    const Block & b = blocks[current];
+    const size_t start = (used + align - 1) / align * align;
+    if (start + n <= b.size) {
+      used = start + n;
+      return b.mem + start;
+    }
+    ++current;
+    used = 0;
+  }
+  // malloc aligns to max_align_t, which is enough for any node
+  const size_t size = max(block_size, n);
+  char* mem = static_cast<char*>(malloc(size));
+  if (mem == nullptr) throw bad_alloc();
+  blocks.push_back(Block{mem, size});
+  current = blocks.size() - 1;
+  used = n;
+  return mem;
+}
+
+size_t NodeArena::capacity() const {
+  size_t c = 0;
+  for (auto & b : blocks) c += b.size;
+  return c;
+}
+
+} // namespace dynet
@@ -0,0 +1,46 @@
+#ifndef DYNET_NODE_ARENA_H
+#define DYNET_NODE_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+namespace dynet {
+
+/**
+ * \brief A bump allocator for the nodes of a computation graph
+ * \details Memory is taken from large blocks of host memory and is only
+ *          given back all at once by reset(), which keeps the blocks for the
+ *          next graph. Objects allocated in the arena must be destroyed
+ *          explicitly before that.
+ */
+class NodeArena {
+ public:
+  explicit NodeArena(size_t block_size = 1 << 16) : block_size(block_size), current(0), used(0) {}
+  ~NodeArena();
+  NodeArena(const NodeArena&) = delete;
+  NodeArena& operator=(const NodeArena&) = delete;
+
+  void* allocate(size_t n, size_t align);
+  /**
+   * \brief Releases all the allocations, and keeps the blocks
+   */
+  void reset() { current = 0; used = 0; }
+  /**
+   * \brief Number of bytes held by the arena
+   */
+  size_t capacity() const;
+
+ private:
+  struct Block {
+    char* mem;
+    size_t size;
+  };
+  size_t block_size;
+  std::vector<Block> blocks;
+  size_t current; // index of the block allocations are taken from
+  size_t used; // bytes used in the current block
+};
+
+} // namespace dynet
+
+#endif
@@ -75,6 +75,13 @@ string SelectRows::as_string(const vector<string>& arg_names) const {
   return s.str();
 }
 
+// the rows are compared by value, unless they are bound to a vector that
+// may change before the graph is executed again
+bool SelectRows::cse_equal(const Node& other) const {
+  const SelectRows& o = static_cast<const SelectRows&>(other);
+  return prows == &rows && o.prows == &o.rows && rows == o.rows;
+}
+
 Dim SelectRows::dim_forward(const vector<Dim>& xs) const {
   DYNET_ARG_CHECK(xs.size() == 1 && xs[0].ndims() == 2, "Bad arguments in SelectRows: " << xs);
   unsigned nrows = prows->size();
@@ -88,6 +95,13 @@ string SelectCols::as_string(const vector<string>& arg_names) const {
   return s.str();
 }
 
+// the cols are compared by value, unless they are bound to a vector that
+// may change before the graph is executed again
+bool SelectCols::cse_equal(const Node& other) const {
+  const SelectCols& o = static_cast<const SelectCols&>(other);
+  return pcols == &cols && o.pcols == &o.cols && cols == o.cols;
+}
+
 Dim SelectCols::dim_forward(const vector<Dim>& xs) const {
   DYNET_ARG_CHECK(xs.size() == 1 && xs[0].ndims() == 2, "Bad arguments in SelectCols: " << xs);
   unsigned ncols = pcols->size();
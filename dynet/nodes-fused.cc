@@ -0,0 +1,275 @@
+#include "dynet/nodes-fused.h"
+
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+#include "dynet/simd-functors.h"
+#include "dynet/functors.h"
+#include "dynet/nodes-macros.h"
+
+using namespace std;
+
+namespace dynet {
+
+// number of elements that FusedElementwise processes at a time
+static const size_t fused_block_size = 256;
+
+typedef Eigen::TensorMap<Eigen::Tensor<float, 1>> FusedVec;
+
+#ifndef __CUDACC__
+
+static const char* fused_op_name(nt::NodeType type) {
+  switch (type) {
+    case nt::tanh: return "tanh";
+    case nt::sqrt: return "sqrt";
+    case nt::abs: return "abs";
+    case nt::erf: return "erf";
+    case nt::square: return "square";
+    case nt::cube: return "cube";
+    case nt::exp: return "exp";
+    case nt::log: return "log";
+    case nt::negate: return "negate";
+    case nt::rectify: return "rectify";
+    case nt::logistic: return "logistic";
+    case nt::softsign: return "softsign";
+    case nt::identity: return "identity";
+    case nt::plus_const: return "plus_const";
+    case nt::scalar_mult: return "scalar_mult";
+    case nt::cmult: return "cmult";
+    case nt::sum: return "sum";
+    default: return "?";
+  }
+}
+
+string FusedElementwise::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "fused(";
+  for (unsigned i = 0; i < arg_names.size(); ++i)
+    s << (i ? "," : "") << arg_names[i];
+  s << " ->";
+  for (auto & op : ops)
+    s << ' ' << fused_op_name(op.type);
+  s << ')';
+  return s.str();
+}
+
+Dim FusedElementwise::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() > 0, "Failed input count check in FusedElementwise");
+  for (unsigned i = 1; i < xs.size(); ++i)
+    DYNET_ARG_CHECK(xs[i] == xs[0], "Mismatched input dimensions in FusedElementwise: " << xs);
+  return xs[0];
+}
+
+int FusedElementwise::autobatch_sig(const ComputationGraph &cg, SigMap &sm) const {
+  Sig s(nt::fused);
+  s.add_dim(dim);
+  s.add_node(args.size());
+  for (auto & op : ops) {
+    s.add_int(op.type);
+    int c;
+    memcpy(&c, &op.c, sizeof(c));
+    s.add_int(c);
+    s.add_node(op.operands.size());
+    for (unsigned operand : op.operands)
+      s.add_node(operand);
+  }
+  return sm.get_idx(s);
+}
+
+// In inference mode only the intermediate values of one block are stored.
+// Otherwise all of them are kept for the backward pass, which also needs the
+// gradients of the inputs and those of the steps of one block.
+size_t FusedElementwise::aux_storage_size() const {
+  const size_t n = dim.size(), block = min(n, fused_block_size);
+  if (for_inference())
+    return (ops.size() - 1) * block * sizeof(float);
+  return ((ops.size() - 1 + args.size()) * n + (ops.size() - 1) * block) * sizeof(float);
+}
+
+string FusedAway::as_string(const vector<string>& arg_names) const {
+  return "fused_away()";
+}
+
+Dim FusedAway::dim_forward(const vector<Dim>& xs) const {
+  // graph_optimize() gives the node the dimensions of the node it replaces
+  return dim;
+}
+
+#endif
+
+// Computes one step of the program over len elements: y = op(x)
+template<class MyDevice>
+void fused_forward(const MyDevice & dev, const FusedElementwise::Op & op, const vector<float*>& vals, size_t len, float* y_ptr) {
+  FusedVec y(y_ptr, len), x(vals[op.operands[0]], len);
+  switch (op.type) {
+    case nt::tanh: y.device(*dev.edevice) = x.tanh(); break;
+    case nt::sqrt: y.device(*dev.edevice) = x.sqrt(); break;
+    case nt::abs: y.device(*dev.edevice) = x.abs(); break;
+    case nt::erf: y.device(*dev.edevice) = x.erf(); break;
+    case nt::square: y.device(*dev.edevice) = x.square(); break;
+    case nt::cube: y.device(*dev.edevice) = x.cube(); break;
+    case nt::exp: y.device(*dev.edevice) = x.exp(); break;
+    case nt::log: y.device(*dev.edevice) = x.log(); break;
+    case nt::negate: y.device(*dev.edevice) = -x; break;
+    case nt::rectify: y.device(*dev.edevice) = x.cwiseMax(0.f); break;
+    case nt::logistic: y.device(*dev.edevice) = x.unaryExpr(scalar_logistic_sigmoid_op<float>()); break;
+    case nt::softsign: y.device(*dev.edevice) = x.unaryExpr(FSoftSign()); break;
+    case nt::identity: y.device(*dev.edevice) = x; break;
+    case nt::plus_const: y.device(*dev.edevice) = x + op.c; break;
+    case nt::scalar_mult: y.device(*dev.edevice) = x * op.c; break;
+    case nt::cmult: y.device(*dev.edevice) = x * FusedVec(vals[op.operands[1]], len); break;
+    case nt::sum:
+      y.device(*dev.edevice) = x + FusedVec(vals[op.operands[1]], len);
+      for (size_t k = 2; k < op.operands.size(); ++k)
+        y.device(*dev.edevice) += FusedVec(vals[op.operands[k]], len);
+      break;
+    default: throw std::runtime_error("Unsupported operation in FusedElementwise");
+  }
+}
+
+// Adds the expression e to the gradient g, or assigns it if g was not
+// written yet, which saves zeroing the gradients first
+template<class MyDevice, class Expr>
+void add_fused_grad(const MyDevice & dev, float* g, size_t len, const Expr & e, char & written) {
+  FusedVec dEdx(g, len);
+  if (written)
+    dEdx.device(*dev.edevice) += e;
+  else
+    dEdx.device(*dev.edevice) = e;
+  written = true;
+}
+
+// Propagates the gradient dEdy of one step of the program, with result y,
+// to the gradients of its operands over len elements
+template<class MyDevice>
+void fused_backward(const MyDevice & dev, const FusedElementwise::Op & op, const vector<float*>& vals, const vector<float*>& grads, vector<char>& written, size_t len, float* y_ptr, float* dEdy_ptr) {
+  FusedVec y(y_ptr, len), dEdy(dEdy_ptr, len), x(vals[op.operands[0]], len);
+  const unsigned a = op.operands[0];
+  switch (op.type) {
+    case nt::tanh: add_fused_grad(dev, grads[a], len, y.binaryExpr(dEdy, scalar_tanh_backward_op<float>()), written[a]); break;
+    case nt::sqrt: add_fused_grad(dev, grads[a], len, y.binaryExpr(dEdy, FSqrtBackward()), written[a]); break;
+    case nt::abs: add_fused_grad(dev, grads[a], len, dEdy * x.sign(), written[a]); break;
+    case nt::erf: add_fused_grad(dev, grads[a], len, x.binaryExpr(dEdy, scalar_erf_backward_op<float>()), written[a]); break;
+    case nt::square: add_fused_grad(dev, grads[a], len, dEdy * x * 2.f, written[a]); break;
+    case nt::cube: add_fused_grad(dev, grads[a], len, dEdy * x.square() * 3.f, written[a]); break;
+    case nt::exp: add_fused_grad(dev, grads[a], len, dEdy * y, written[a]); break;
+    case nt::log: add_fused_grad(dev, grads[a], len, dEdy / x, written[a]); break;
+    case nt::negate: add_fused_grad(dev, grads[a], len, -dEdy, written[a]); break;
+    case nt::rectify: add_fused_grad(dev, grads[a], len, y.binaryExpr(dEdy, FRectifyBackward()), written[a]); break;
+    case nt::logistic: add_fused_grad(dev, grads[a], len, y.binaryExpr(dEdy, scalar_logistic_sigmoid_backward_op<float>()), written[a]); break;
+    case nt::softsign: add_fused_grad(dev, grads[a], len, y.binaryExpr(dEdy, FSoftSignBackward()), written[a]); break;
+    case nt::identity: add_fused_grad(dev, grads[a], len, dEdy, written[a]); break;
+    case nt::plus_const: add_fused_grad(dev, grads[a], len, dEdy, written[a]); break;
+    case nt::scalar_mult: add_fused_grad(dev, grads[a], len, dEdy * op.c, written[a]); break;
+    case nt::cmult: {
+      const unsigned b = op.operands[1];
+      add_fused_grad(dev, grads[a], len, dEdy * FusedVec(vals[b], len), written[a]);
+      add_fused_grad(dev, grads[b], len, dEdy * x, written[b]);
+      break;
+    }
+    case nt::sum:
+      for (unsigned operand : op.operands)
+        add_fused_grad(dev, grads[operand], len, dEdy, written[operand]);
+      break;
+    default: throw std::runtime_error("Unsupported operation in FusedElementwise");
+  }
+}
+
+template<class MyDevice>
+void FusedElementwise::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  throw std::runtime_error("FusedElementwise::forward_dev_impl not supported on GPU");
+#else
+  // the program runs one step at a time over blocks of elements small
+  // enough for the intermediate values of a block to stay in cache. They are
+  // kept in auxiliary memory for the backward pass, unless in inference mode.
+  const size_t arity = xs.size(), n = fx.d.size();
+  const bool keep = !for_inference();
+  const size_t stride = keep ? n : min(n, fused_block_size);
+  float* intermediates = static_cast<float*>(aux_mem);
+  vector<float*> vals(arity + ops.size());
+  for (size_t b = 0; b < n; b += fused_block_size) {
+    const size_t len = min(fused_block_size, n - b);
+    for (size_t k = 0; k < arity; ++k)
+      vals[k] = xs[k]->v + b;
+    for (size_t s = 0; s + 1 < ops.size(); ++s)
+      vals[arity + s] = intermediates + s * stride + (keep ? b : 0);
+    vals.back() = fx.v + b;
+    for (size_t s = 0; s < ops.size(); ++s)
+      fused_forward(dev, ops[s], vals, len, vals[arity + s]);
+  }
+  grads_ready = false;
+#endif
+}
+
+template<class MyDevice>
+void FusedElementwise::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  throw std::runtime_error("FusedElementwise::backward_dev_impl not supported on GPU");
+#else
+  // the first call after forward propagates dEdf back through the whole
+  // program once. It adds the gradient of input i to dEdxi, and stores those
+  // of the other inputs in auxiliary memory for the calls that follow.
+  const size_t arity = xs.size(), n = fx.d.size(), nops = ops.size();
+  float* intermediates = static_cast<float*>(aux_mem);
+  float* input_grads = intermediates + (nops - 1) * n;
+  if (!grads_ready || grads_taken[i]) {
+    float* step_grads = input_grads + arity * n;
+    const size_t block = min(n, fused_block_size);
+    vector<float*> vals(arity + nops), grads(arity + nops);
+    vector<char> written(arity + nops);
+    for (size_t b = 0; b < n; b += fused_block_size) {
+      const size_t len = min(fused_block_size, n - b);
+      for (size_t k = 0; k < arity; ++k) {
+        vals[k] = xs[k]->v + b;
+        grads[k] = (k == i ? dEdxi.v : input_grads + k * n) + b;
+      }
+      for (size_t s = 0; s + 1 < nops; ++s) {
+        vals[arity + s] = intermediates + s * n + b;
+        grads[arity + s] = step_grads + s * block;
+      }
+      vals.back() = fx.v + b;
+      grads.back() = dEdf.v + b;
+      fill(written.begin(), written.end(), 0);
+      written[i] = 1;
+      for (size_t s = nops; s-- > 0; )
+        fused_backward(dev, ops[s], vals, grads, written, len, vals[arity + s], grads[arity + s]);
+      // inputs that the gradient does not reach
+      for (size_t k = 0; k < arity; ++k)
+        if (!written[k])
+          FusedVec(grads[k], len).setZero();
+    }
+    grads_ready = true;
+    grads_taken.assign(arity, false);
+  } else {
+    dEdxi.tvec().device(*dev.edevice) += FusedVec(input_grads + i * n, n);
+  }
+  grads_taken[i] = true;
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(FusedElementwise)
+
+template<class MyDevice>
+void FusedAway::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+  // the node was removed, its value is not needed
+}
+
+template<class MyDevice>
+void FusedAway::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+  throw std::runtime_error("FusedAway has no inputs to backpropagate to");
+}
+DYNET_NODE_INST_DEV_IMPL(FusedAway)
+
+} // namespace dynet
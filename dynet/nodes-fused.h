@@ -0,0 +1,51 @@
+#ifndef DYNET_NODES_FUSED_H_
+#define DYNET_NODES_FUSED_H_
+
+#include "dynet/dynet.h"
+#include "dynet/nodes-macros.h"
+#include "dynet/sig.h"
+
+namespace dynet {
+
+// A chain of elementwise operations over inputs that all have the output's
+// dimensions, created by graph_optimize(). The program runs one step at a
+// time over blocks of elements, so the intermediate values of a block stay in
+// cache instead of going through memory between separate nodes. They are
+// kept in auxiliary memory for the backward pass, which propagates the
+// gradient through the whole program once for all the inputs. Only
+// implemented on CPU. Nodes running the same program on inputs of the same
+// dimensions are batched together.
+struct FusedElementwise : public Node {
+  // One step of the program. Operands < arity() refer to the inputs of the
+  // node, operand arity()+k refers to the result of step k.
+  struct Op {
+    nt::NodeType type;
+    std::vector<unsigned> operands;
+    float c; // the constant of plus_const and scalar_mult
+  };
+  explicit FusedElementwise(const std::vector<VariableIndex>& a, const std::vector<Op>& ops) : Node(a), ops(ops), grads_ready(false) {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual size_t aux_storage_size() const override;
+  virtual bool supports_multibatch() const override { return true; }
+  virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override;
+  virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(args.size(), 1); }
+  std::vector<Op> ops;
+  // whether the gradients of the inputs in aux_mem are those of the last
+  // forward pass, and which of them were already returned by backward
+  mutable bool grads_ready;
+  mutable std::vector<bool> grads_taken;
+};
+
+// Takes the place of a node removed by graph_optimize(): fused into a
+// FusedElementwise node, merged with an identical node, or not needed by
+// the outputs. Its value is never computed.
+struct FusedAway : public Node {
+  FusedAway() {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  virtual bool has_value() const override { return false; }
+};
+
+} // namespace dynet
+
+#endif
@@ -100,23 +100,23 @@ EIGEN_STRONG_INLINE real logsumexp(const T& x, const vector<unsigned>& denom) {
 
 size_t BlockDropout::aux_storage_size() const {
   // we just need to remember whether this entire block is turned on (1.0) or off (0.0)
-  return 1 * sizeof(float);
+  return for_inference() ? 0 : 1 * sizeof(float);
 }
 
 size_t Dropout::aux_storage_size() const {
-  return dim.size() * sizeof(float);
+  return for_inference() ? 0 : dim.size() * sizeof(float);
 }
 
 size_t DropoutDim::aux_storage_size() const {
-  return (dim.size() / dim[dimension]) * sizeof(float);
+  return for_inference() ? 0 : (dim.size() / dim[dimension]) * sizeof(float);
 }
 
 size_t DropoutBatch::aux_storage_size() const {
-  return dim.batch_elems() * sizeof(float);
+  return for_inference() ? 0 : dim.batch_elems() * sizeof(float);
 }
 
 size_t GaussianNoise::aux_storage_size() const {
-  return dim.size() * sizeof(float);
+  return for_inference() ? 0 : dim.size() * sizeof(float);
 }
 
 size_t Hinge::aux_storage_size() const {
@@ -137,12 +137,14 @@ size_t LogSumExp::aux_storage_size() const {
   return (MAX_LOG_SUM_EXP + 1) * sizeof(float);
 }
 
+// the masks of Max and Min and the indices of MaxDimension and MinDimension
+// are only needed for backward
 size_t Max::aux_storage_size() const {
-  return dim.size() * sizeof(float);
+  return for_inference() ? 0 : dim.size() * sizeof(float);
 }
 
 size_t Min::aux_storage_size() const {
-  return dim.size() * sizeof(float);
+  return for_inference() ? 0 : dim.size() * sizeof(float);
 }
 
 size_t Softmax::aux_storage_size() const {
@@ -160,11 +162,11 @@ size_t SparsemaxLoss::aux_storage_size() const {
 }
 
 size_t MaxDimension::aux_storage_size() const {
-  return sizeof(Eigen::DenseIndex) * dim.size();
+  return for_inference() ? 0 : sizeof(Eigen::DenseIndex) * dim.size();
 }
 
 size_t MinDimension::aux_storage_size() const {
-  return sizeof(Eigen::DenseIndex) * dim.size();
+  return for_inference() ? 0 : sizeof(Eigen::DenseIndex) * dim.size();
 }
 
 #endif // Finish CPU only functions
@@ -570,6 +572,10 @@ DYNET_NODE_INST_DEV_IMPL(BinaryLogLoss)
 
 template<class MyDevice>
 void BlockDropout::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+  if (for_inference()) {
+    fx.tvec().device(*dev.edevice) = xs[0]->tvec();
+    return;
+  }
   bernoulli_distribution distribution(1.0 - dropout_probability);
   float block_multiplier = distribution(*rndeng)? 1.0 : 0.0;
   block_multiplier = 
@@ -882,6 +888,11 @@ DYNET_NODE_INST_DEV_IMPL(DotProduct)
 
 template<class MyDevice>
 void Dropout::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+  // the kept values are scaled while training, so this is the identity at test time
+  if (for_inference()) {
+    fx.tvec().device(*dev.edevice) = xs[0]->tvec();
+    return;
+  }
   Tensor m(dim, (float*)aux_mem, fx.device, DeviceMempool::FXS);
   TensorTools::randomize_bernoulli(m, (1.f-p), 1.f / (1.f-p));
   fx.tvec().device(*dev.edevice) = xs[0]->tvec() * m.tvec();
@@ -902,6 +913,10 @@ DYNET_NODE_INST_DEV_IMPL(Dropout)
 
 template<class MyDevice>
 void DropoutBatch::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+  if (for_inference()) {
+    fx.tvec().device(*dev.edevice) = xs[0]->tvec();
+    return;
+  }
   Dim mask_dim({1},xs[0]->d.batch_elems());
   Tensor m(mask_dim, (float*)aux_mem, fx.device, DeviceMempool::FXS);
   TensorTools::randomize_bernoulli(m, (1.f-p), 1.f / (1.f-p));
@@ -926,6 +941,10 @@ DYNET_NODE_INST_DEV_IMPL(DropoutBatch)
 
 template<class MyDevice>
 void DropoutDim::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+  if (for_inference()) {
+    fx.tvec().device(*dev.edevice) = xs[0]->tvec();
+    return;
+  }
   Dim mask_dim(dim);
   mask_dim.d[dimension]=1;
   Tensor m(mask_dim, (float*)aux_mem, fx.device, DeviceMempool::FXS);
@@ -983,6 +1002,10 @@ DYNET_NODE_INST_DEV_IMPL(Exp)
 
 template<class MyDevice>
 void GaussianNoise::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+  if (for_inference()) {
+    fx.tvec().device(*dev.edevice) = xs[0]->tvec();
+    return;
+  }
   Tensor m(dim, (float*)aux_mem, fx.device, DeviceMempool::FXS);
   TensorTools::randomize_normal(m, 0, stddev);
   fx.tvec().device(*dev.edevice) = xs[0]->tvec() + m.tvec();
@@ -1448,8 +1471,10 @@ DYNET_NODE_INST_DEV_IMPL(MatrixMultiply)
 
 template<class MyDevice>
 void Max::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-  Tensor t(fx.d, static_cast<float*>(aux_mem), fx.device, DeviceMempool::FXS);
-  t.tvec().device(*dev.edevice) = (xs[0]->tvec() > xs[1]->tvec()).cast<float>();
+  if (!for_inference()) {
+    Tensor t(fx.d, static_cast<float*>(aux_mem), fx.device, DeviceMempool::FXS);
+    t.tvec().device(*dev.edevice) = (xs[0]->tvec() > xs[1]->tvec()).cast<float>();
+  }
   fx.tvec().device(*dev.edevice) = xs[0]->tvec().cwiseMax(xs[1]->tvec());
 }
 
@@ -1557,8 +1582,10 @@ DYNET_NODE_INST_DEV_IMPL(MaxPooling1D)
 
 template<class MyDevice>
 void Min::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-  Tensor t(fx.d, static_cast<float*>(aux_mem), fx.device, DeviceMempool::FXS);
-  t.tvec().device(*dev.edevice) = (xs[0]->tvec() < xs[1]->tvec()).cast<float>();
+  if (!for_inference()) {
+    Tensor t(fx.d, static_cast<float*>(aux_mem), fx.device, DeviceMempool::FXS);
+    t.tvec().device(*dev.edevice) = (xs[0]->tvec() < xs[1]->tvec()).cast<float>();
+  }
   fx.tvec().device(*dev.edevice) = xs[0]->tvec().cwiseMin(xs[1]->tvec());
 }
 
@@ -2236,7 +2263,7 @@ void L2Norm::backward_dev_impl(const MyDevice & dev,
                              Tensor& dEdxi) const {
   DYNET_ASSERT(i < 1, "Failed dimension check in L2Norm::backward");
   Eigen::array<ptrdiff_t, 2> bcast = {xs[0]->d.batch_size(), 1};
-  dEdxi.tbvec().device(*dev.edevice) += xs[0]->tbvec() * ((fx.tvec() / (float) xs[0]->d.batch_size()).binaryExpr(dEdf.tvec(), FSqrtBackward())).broadcast(bcast);
+  dEdxi.tbvec().device(*dev.edevice) += xs[0]->tbvec() * ((fx.tbvec() / (float) xs[0]->d.batch_size()).binaryExpr(dEdf.tbvec(), FSqrtBackward())).broadcast(bcast);
 
 }
 DYNET_NODE_INST_DEV_IMPL(L2Norm)
@@ -2744,13 +2771,15 @@ DYNET_NODE_INST_DEV_IMPL(RandomGumbel)
 
 template<class MyDevice>
 void MaxDimension::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-  Eigen::DenseIndex* maxmap = static_cast<Eigen::DenseIndex*>(aux_mem);
-  const unsigned batch_size = dim.batch_elems();
-  const unsigned first_dim_size = dim[0];
-  const unsigned second_dim_size = dim[1];
-  Eigen::TensorMap<Eigen::Tensor<Eigen::DenseIndex, 3>> locs(maxmap, first_dim_size, second_dim_size, batch_size);
   const Eigen::array<Eigen::DenseIndex, 1> reduction_axis = {reduced_dim};
-  locs.device(*dev.edevice) = xs[0]->tb<3>().argmax(reduced_dim);
+  if (!for_inference()) {
+    Eigen::DenseIndex* maxmap = static_cast<Eigen::DenseIndex*>(aux_mem);
+    const unsigned batch_size = dim.batch_elems();
+    const unsigned first_dim_size = dim[0];
+    const unsigned second_dim_size = dim[1];
+    Eigen::TensorMap<Eigen::Tensor<Eigen::DenseIndex, 3>> locs(maxmap, first_dim_size, second_dim_size, batch_size);
+    locs.device(*dev.edevice) = xs[0]->tb<3>().argmax(reduced_dim);
+  }
   fx.tb<2>().device(*dev.edevice) = xs[0]->tb<3>().maximum(reduction_axis);
 }
 
@@ -2793,13 +2822,15 @@ DYNET_NODE_INST_DEV_IMPL(MaxDimension)
 
 template<class MyDevice>
 void MinDimension::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-  Eigen::DenseIndex* minmap = static_cast<Eigen::DenseIndex*>(aux_mem);
-  const unsigned batch_size = dim.batch_elems();
-  const unsigned first_dim_size = dim[0];
-  const unsigned second_dim_size = dim[1];
-  Eigen::TensorMap<Eigen::Tensor<Eigen::DenseIndex, 3>> locs(minmap, first_dim_size, second_dim_size, batch_size);
   const Eigen::array<Eigen::DenseIndex, 1> reduction_axis = {reduced_dim};
-  locs.device(*dev.edevice) = xs[0]->tb<3>().argmin(reduced_dim);
+  if (!for_inference()) {
+    Eigen::DenseIndex* minmap = static_cast<Eigen::DenseIndex*>(aux_mem);
+    const unsigned batch_size = dim.batch_elems();
+    const unsigned first_dim_size = dim[0];
+    const unsigned second_dim_size = dim[1];
+    Eigen::TensorMap<Eigen::Tensor<Eigen::DenseIndex, 3>> locs(minmap, first_dim_size, second_dim_size, batch_size);
+    locs.device(*dev.edevice) = xs[0]->tb<3>().argmin(reduced_dim);
+  }
   fx.tb<2>().device(*dev.edevice) = xs[0]->tb<3>().minimum(reduction_axis);
 }
 
@@ -49,6 +49,7 @@ struct MatrixInverse : public Node {
 struct SelectRows : public Node {
   explicit SelectRows(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& r) : Node(a), rows(r), prows(&rows) {}
   explicit SelectRows(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>* pr) : Node(a), prows(pr) {}
+  virtual bool cse_equal(const Node& other) const override;
   DYNET_NODE_DEFINE_DEV_IMPL()
   std::vector<unsigned> rows;
   const std::vector<unsigned>* prows;
@@ -59,6 +60,7 @@ struct SelectRows : public Node {
 struct SelectCols : public Node {
   explicit SelectCols(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& c) : Node(a), cols(c), pcols(&cols) {}
   explicit SelectCols(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>* pc) : Node(a), pcols(pc) {}
+  virtual bool cse_equal(const Node& other) const override;
   DYNET_NODE_DEFINE_DEV_IMPL()
   std::vector<unsigned> cols;
   const std::vector<unsigned>* pcols;
@@ -99,6 +101,7 @@ struct ConstScalarMultiply : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::scalar_mult); s.add_node(*((int*)&alpha)); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }
+  virtual bool cse_equal(const Node& other) const override { return alpha == static_cast<const ConstScalarMultiply&>(other).alpha; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   float alpha;
 };
@@ -107,6 +110,7 @@ struct ConstScalarMultiply : public Node {
 struct DotProduct : public Node {
   explicit DotProduct(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -115,6 +119,7 @@ struct DotProduct : public Node {
 // if you have a matrix as input, the runtime is O(mn) - try to avoid using this
 struct Transpose : public Node {
   explicit Transpose(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned> & dims) : Node(a), dims(dims) {}
+  virtual bool cse_equal(const Node& other) const override { return dims == static_cast<const Transpose&>(other).dims; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   virtual bool supports_multibatch() const override { return true; }
   std::vector<unsigned> dims;
@@ -140,6 +145,7 @@ struct KMHNGram : public Node {
 struct GaussianNoise : public Node {
   explicit GaussianNoise(const std::initializer_list<VariableIndex>& a, real stddev) : Node(a), stddev(stddev) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return !for_inference(); }
   size_t aux_storage_size() const override;
   virtual bool supports_multibatch() const override { return true; }
   real stddev;
@@ -149,6 +155,7 @@ struct GaussianNoise : public Node {
 struct Dropout : public Node {
   explicit Dropout(const std::initializer_list<VariableIndex>& a, real p) : Node(a), p(p) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return !for_inference(); }
   size_t aux_storage_size() const override;
   virtual bool supports_multibatch() const override { return true; }
   real p;
@@ -158,6 +165,7 @@ struct Dropout : public Node {
 struct DropoutDim : public Node {
   explicit DropoutDim(const std::initializer_list<VariableIndex>& a, unsigned d,real p) : Node(a), dimension(d), p(p) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return !for_inference(); }
   size_t aux_storage_size() const override;
   virtual bool supports_multibatch() const override { return true; }
   unsigned dimension;
@@ -168,6 +176,7 @@ struct DropoutDim : public Node {
 struct DropoutBatch : public Node {
   explicit DropoutBatch(const std::initializer_list<VariableIndex>& a, real p) : Node(a), p(p) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return !for_inference(); }
   size_t aux_storage_size() const override;
   virtual bool supports_multibatch() const override { return true; }
   real p;
@@ -177,6 +186,7 @@ struct DropoutBatch : public Node {
 struct BlockDropout : public Node {
   explicit BlockDropout(const std::initializer_list<VariableIndex>& a, real p) : Node(a), dropout_probability(p) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return !for_inference(); }
   size_t aux_storage_size() const override;
   real dropout_probability;
 };
@@ -188,6 +198,7 @@ struct ConstantPlusX : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::plus_const); s.add_node(*((int*)&c)); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return c == static_cast<const ConstantPlusX&>(other).c; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   real c;
 };
@@ -197,6 +208,7 @@ struct ConstantPlusX : public Node {
 struct ConstantMinusX : public Node {
   explicit ConstantMinusX(const std::initializer_list<VariableIndex>& a, real o) : Node(a), c(o) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return c == static_cast<const ConstantMinusX&>(other).c; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   real c;
 };
@@ -207,6 +219,7 @@ struct Sqrt : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::sqrt); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -216,6 +229,7 @@ struct Abs : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::abs); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -225,6 +239,7 @@ struct Erf : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::erf); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -234,6 +249,7 @@ struct Tanh : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::tanh); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -243,6 +259,7 @@ struct Square : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::square); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -252,6 +269,7 @@ struct Cube : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::cube); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -261,6 +279,7 @@ struct Exp : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::exp); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -270,6 +289,7 @@ struct LogGamma : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::loggamma); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -279,6 +299,7 @@ struct Log : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::log); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -361,6 +382,7 @@ struct Identity : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::identity); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -388,6 +410,7 @@ struct MatrixMultiply : public Node {
                                  Tensor& fx) const override {
     autobatch_reshape_concatonly(cg, batch_ids, concat, xs, fx);
   }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -397,6 +420,7 @@ struct CwiseMultiply : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override;
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override;
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -404,6 +428,7 @@ struct CwiseMultiply : public Node {
 struct ScalarAdd : public Node {
   explicit ScalarAdd(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -411,6 +436,7 @@ struct ScalarAdd : public Node {
 struct ScalarMultiply : public Node {
   explicit ScalarMultiply(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -418,6 +444,7 @@ struct ScalarMultiply : public Node {
 struct ScalarQuotient : public Node {
   explicit ScalarQuotient(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -425,6 +452,7 @@ struct ScalarQuotient : public Node {
 struct CwiseQuotient : public Node {
   explicit CwiseQuotient(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -441,6 +469,7 @@ struct AffineTransform : public Node {
                                  Tensor& fx) const override {
     autobatch_reshape_concatonly(cg, batch_ids, concat, xs, fx);
   }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   mutable float* dEdf_mem;
 };
@@ -451,6 +480,7 @@ struct Negate : public Node {
   virtual bool supports_multibatch() const override { return true; } 
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::negate); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -460,6 +490,7 @@ struct Rectify : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::rectify); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -500,6 +531,7 @@ struct Sum : public Node {
     if(dim.bd != 1)
       autobatch_reshape_concatonly(cg, batch_ids, concat, xs, fx);
   }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   virtual bool supports_multibatch() const override { return true; }
 };
@@ -507,6 +539,7 @@ struct Sum : public Node {
 // y = \sum_i,j,... x[i,j,...]
 struct SumElements : public Node {
   template <typename T> explicit SumElements(const T& a) : Node(a) {}
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   virtual bool supports_multibatch() const override { return true; }
 };
@@ -596,6 +629,7 @@ struct PoissonRegressionLoss : public Node {
 struct SquaredNorm : public Node {
   explicit SquaredNorm(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -603,6 +637,7 @@ struct SquaredNorm : public Node {
 struct L2Norm : public Node {
   explicit L2Norm(const std::initializer_list<VariableIndex>& a) : Node(a) {}
   virtual bool supports_multibatch() const override { return true; }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -619,6 +654,7 @@ struct SquaredEuclideanDistance : public Node {
                                  Tensor& fx) const override {
     autobatch_reshape_concatonly(cg, batch_ids, concat, xs, fx);
   }
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -632,6 +668,7 @@ struct HuberDistance : public Node {
 // y = || x_1 - x_2 ||_1
 struct L1Distance : public Node {
   explicit L1Distance(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -641,6 +678,7 @@ struct LogisticSigmoid : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::logistic); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -650,6 +688,7 @@ struct SoftSign : public Node {
   virtual bool supports_multibatch() const override { return true; }
   virtual int autobatch_sig(const ComputationGraph &cg, SigMap &sm) const override { Sig s(nt::softsign); return sm.get_idx(s); }
   virtual std::vector<int> autobatch_concat(const ComputationGraph & cg) const override { return std::vector<int>(1, 1); }  
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -657,6 +696,7 @@ struct SoftSign : public Node {
 // y_i = (x_1)_i / z
 struct Softmax : public Node {
   explicit Softmax(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  virtual bool cse_equal(const Node& other) const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   size_t aux_storage_size() const override;
   virtual bool supports_multibatch() const override { return true; }
@@ -781,6 +821,7 @@ struct Zeroes : public Node {
 struct RandomNormal : public Node {
   explicit RandomNormal(const Dim& d) : dim(d) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return true; }
   Dim dim;
 };
 
@@ -790,6 +831,7 @@ struct RandomBernoulli : public Node {
     DYNET_ASSERT(a.size() == 0, "RandomBernoulli doesn't accept nodes as input");
   }
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return true; }
   Dim dim;
   real p;
   real scale;
@@ -801,6 +843,7 @@ struct RandomUniform : public Node {
     DYNET_ASSERT(a.size() == 0, "RandomUniform doesn't accept nodes as input");
   }
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return true; }
   Dim dim;
   real left, right;
 };
@@ -811,6 +854,7 @@ struct RandomGumbel : public Node {
     DYNET_ASSERT(a.size() == 0, "RandomGumbel doesn't accept nodes as input");
   }
   DYNET_NODE_DEFINE_DEV_IMPL()
+  bool is_stochastic() const override { return true; }
   Dim dim;
   real mu, beta;
 };
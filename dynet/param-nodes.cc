@@ -17,12 +17,24 @@ namespace dynet {
 
 #ifndef __CUDACC__
 
+// the storage of the parameter or lookup parameter read by a parameter node
+static const void* parameter_storage(const Parameter& p, const LookupParameter& lp) {
+  if (p.mp != nullptr) return p.get();
+  if (lp.mp != nullptr) return lp.get();
+  return nullptr;
+}
+
 string ConstParameterNode::as_string(const vector<string>& arg_names) const {
   ostringstream s;
   s << "const_parameters(" << dim << ") @ " << params.get();
   return s.str();
 }
 
+bool ConstParameterNode::cse_equal(const Node& other) const {
+  const ConstParameterNode& o = static_cast<const ConstParameterNode&>(other);
+  return parameter_storage(params, lparams) == parameter_storage(o.params, o.lparams);
+}
+
 Dim ConstParameterNode::dim_forward(const vector<Dim>& xs) const {
   DYNET_ASSERT(xs.size() == 0, "Failed dimension check in FUNCNAME");
   return dim;
@@ -34,6 +46,11 @@ string ParameterNode::as_string(const vector<string>& arg_names) const {
   return s.str();
 }
 
+bool ParameterNode::cse_equal(const Node& other) const {
+  const ParameterNode& o = static_cast<const ParameterNode&>(other);
+  return parameter_storage(params, lparams) == parameter_storage(o.params, o.lparams);
+}
+
 Dim ParameterNode::dim_forward(const vector<Dim>& xs) const {
   DYNET_ASSERT(xs.size() == 0, "Failed dimension check in FUNCNAME");
   return dim;
@@ -15,6 +15,7 @@ struct ParameterNodeBase : public Node {
 struct ParameterNode : public ParameterNodeBase {
   explicit ParameterNode(const Parameter & p) : dim(p.get()->dim), params(p) {}
   explicit ParameterNode(const LookupParameter & lp) : dim(lp.get()->all_dim), lparams(lp) {}
+  virtual bool cse_equal(const Node& other) const override;
   DYNET_NODE_DEFINE_DEV_IMPL()
   void accumulate_grad(const Tensor& g) override;
   Dim dim;
@@ -26,6 +27,7 @@ struct ParameterNode : public ParameterNodeBase {
 struct ConstParameterNode : public Node {
   explicit ConstParameterNode(const Parameter & p) : dim(p.get()->dim), params(p) {}
   explicit ConstParameterNode(const LookupParameter & lp) : dim(lp.get()->all_dim), lparams(lp) {}
+  virtual bool cse_equal(const Node& other) const override;
   DYNET_NODE_DEFINE_DEV_IMPL()
   Dim dim;
   Parameter params;
@@ -0,0 +1,89 @@
+#include "dynet/pipeline.h"
+
+#include "dynet/except.h"
+
+using namespace std;
+
+namespace dynet {
+
+GraphPipeline::GraphPipeline() : executing(false), done(false) {
+  worker = thread([this] { run(); });
+}
+
+GraphPipeline::~GraphPipeline() {
+  building.reset();
+  {
+    unique_lock<mutex> lk(m);
+    done = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void GraphPipeline::run() {
+  while (true) {
+    Job job;
+    {
+      unique_lock<mutex> lk(m);
+      cv.wait(lk, [this] { return done || !jobs.empty(); });
+      if (jobs.empty()) return;
+      job = move(jobs.front());
+      jobs.pop_front();
+      executing = true;
+    }
+    cv.notify_all();
+    exception_ptr e;
+    try {
+      job.cg->attach_to_thread();
+      job.execute(*job.cg);
+    } catch (...) {
+      e = current_exception();
+    }
+    job.cg.reset();
+    {
+      unique_lock<mutex> lk(m);
+      executing = false;
+      if (e && !error) error = e;
+    }
+    cv.notify_all();
+  }
+}
+
+void GraphPipeline::rethrow() {
+  if (error) {
+    exception_ptr e = error;
+    error = nullptr;
+    rethrow_exception(e);
+  }
+}
+
+ComputationGraph& GraphPipeline::new_graph() {
+  if (building)
+    DYNET_RUNTIME_ERR("GraphPipeline::new_graph() called before the previous graph was submitted");
+  {
+    unique_lock<mutex> lk(m);
+    cv.wait(lk, [this] { return jobs.empty(); });
+    rethrow();
+  }
+  building.reset(new ComputationGraph);
+  return *building;
+}
+
+void GraphPipeline::submit(function<void(ComputationGraph&)> execute) {
+  if (!building)
+    DYNET_RUNTIME_ERR("GraphPipeline::submit() called without a graph from new_graph()");
+  building->detach_from_thread();
+  {
+    unique_lock<mutex> lk(m);
+    jobs.push_back(Job{move(building), move(execute)});
+  }
+  cv.notify_all();
+}
+
+void GraphPipeline::wait() {
+  unique_lock<mutex> lk(m);
+  cv.wait(lk, [this] { return jobs.empty() && !executing; });
+  rethrow();
+}
+
+} // namespace dynet
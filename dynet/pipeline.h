@@ -0,0 +1,88 @@
+#ifndef DYNET_PIPELINE_H
+#define DYNET_PIPELINE_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "dynet/dynet.h"
+
+namespace dynet {
+
+/**
+ * \ingroup compgraph
+ * \brief Builds the next computation graph while the current one is executed
+ * \details The calling thread builds graphs, and a worker thread executes
+ *          them one after the other, in the order in which they are submitted:
+ *
+ *          GraphPipeline pipeline;
+ *          for (auto & minibatch : data) {
+ *            ComputationGraph & cg = pipeline.new_graph();
+ *            Expression loss = build_loss(cg, minibatch);
+ *            pipeline.submit([&trainer, loss](ComputationGraph & cg) {
+ *              cg.forward(loss);
+ *              cg.backward(loss);
+ *              trainer.update();
+ *            });
+ *          }
+ *          pipeline.wait();
+ *
+ *          The memory is double-buffered: the graph being built has its own
+ *          nodes, and the graph being executed has its values in the forward
+ *          and backward memory of the worker thread. new_graph() waits while
+ *          a submitted graph has not started executing, so at most two graphs
+ *          are alive at once. A graph is destroyed by the worker after it is
+ *          executed.
+ *          Parameters must only be read and updated by the submitted
+ *          functions, since they run concurrently with the construction of
+ *          the next graph.
+ */
+class GraphPipeline {
+ public:
+  GraphPipeline();
+  ~GraphPipeline();
+  GraphPipeline(const GraphPipeline&) = delete;
+  GraphPipeline& operator=(const GraphPipeline&) = delete;
+
+  /**
+   * \brief Creates the next graph to build in the calling thread
+   * \details The previous graph must have been submitted. Rethrows the
+   *          exception of a failed execution.
+   */
+  ComputationGraph& new_graph();
+  /**
+   * \brief Hands the graph created by new_graph() over to the worker, which
+   *        calls execute with it and then destroys it
+   */
+  void submit(std::function<void(ComputationGraph&)> execute);
+  /**
+   * \brief Waits until all the submitted graphs are executed
+   * \details Rethrows the exception of a failed execution.
+   */
+  void wait();
+
+ private:
+  struct Job {
+    std::unique_ptr<ComputationGraph> cg;
+    std::function<void(ComputationGraph&)> execute;
+  };
+  void run();
+  void rethrow();
+
+  std::unique_ptr<ComputationGraph> building;
+  std::deque<Job> jobs; // submitted jobs that have not started
+  bool executing;
+  bool done;
+  std::exception_ptr error;
+  std::mutex m;
+  std::condition_variable cv;
+  std::thread worker;
+};
+
+} // namespace dynet
+
+#endif
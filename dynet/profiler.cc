@@ -0,0 +1,171 @@
+#include "dynet/profiler.h"
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <typeinfo>
+
+#include "dynet/dynet.h"
+#include "dynet/nodes.h"
+#include "dynet/except.h"
+#include "dynet/globals.h"
+
+using namespace std;
+
+namespace dynet {
+
+// threads are numbered in the order in which they first record an event
+static atomic<unsigned> num_profiled_threads(0);
+static unsigned profile_thread_index() {
+  static thread_local unsigned index = num_profiled_threads++;
+  return index;
+}
+
+// a rough estimate: matrix products count a multiplication and an addition
+// per term, everything else one operation per output element
+static double estimate_flops(const Node* node, const vector<const Tensor*>& xs, const Tensor& fx) {
+  const double bd = fx.d.batch_elems();
+  if (dynamic_cast<const MatrixMultiply*>(node) && xs.size() == 2)
+    return 2.0 * xs[0]->d.rows() * xs[0]->d.cols() * fx.d.cols() * bd;
+  if (dynamic_cast<const AffineTransform*>(node)) {
+    double flops = fx.d.size();
+    for (size_t i = 1; i + 1 < xs.size(); i += 2)
+      flops += 2.0 * xs[i]->d.rows() * xs[i]->d.cols() * fx.d.cols() * bd;
+    return flops;
+  }
+  return fx.d.size();
+}
+
+static string phase_name(ProfilePhase phase) {
+  return phase == ProfilePhase::forward ? "forward" : "backward";
+}
+
+static string dim_string(const Dim& d) {
+  ostringstream oss;
+  oss << d;
+  return oss.str();
+}
+
+static string json_escape(const string& s) {
+  string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+Profiler::Profiler() : epoch(chrono::steady_clock::now()), max_events(default_max_events), dropped(0) {}
+
+void Profiler::start() {
+  clear();
+  profiling_flag = true;
+}
+
+void Profiler::stop() {
+  profiling_flag = false;
+}
+
+void Profiler::clear() {
+  lock_guard<mutex> lk(m);
+  events.clear();
+  dropped = 0;
+  epoch = chrono::steady_clock::now();
+}
+
+void Profiler::set_max_events(size_t n) {
+  lock_guard<mutex> lk(m);
+  max_events = n;
+}
+
+size_t Profiler::num_dropped() const {
+  lock_guard<mutex> lk(m);
+  return dropped;
+}
+
+// Node::type_name() demangles the name, so the names are cached
+const string& Profiler::type_name(const Node* node) {
+  type_index t(typeid(*node));
+  auto it = type_names.find(t);
+  if (it != type_names.end()) return it->second;
+  return type_names[t] = node->type_name();
+}
+
+void Profiler::record(const Node* node, ProfilePhase phase, const vector<const Tensor*>& xs, const Tensor& fx, time_point begin, time_point end) {
+  ProfileEvent e;
+  e.dim = fx.d;
+  e.phase = phase;
+  e.thread = profile_thread_index();
+  e.bytes = (phase == ProfilePhase::forward ? fx.d.size() * sizeof(float) + node->aux_storage_size() : 0);
+  e.flops = estimate_flops(node, xs, fx);
+  lock_guard<mutex> lk(m);
+  if (events.size() >= max_events) {
+    ++dropped;
+    return;
+  }
+  e.type = type_name(node);
+  e.start = chrono::duration<double, micro>(begin - epoch).count();
+  e.duration = chrono::duration<double, micro>(end - begin).count();
+  events.push_back(e);
+}
+
+vector<ProfileEvent> Profiler::get_events() const {
+  lock_guard<mutex> lk(m);
+  return events;
+}
+
+map<Profiler::Key, ProfileStats> Profiler::get_summary() const {
+  map<Key, ProfileStats> summary;
+  lock_guard<mutex> lk(m);
+  for (auto & e : events) {
+    ProfileStats & stats = summary[Key(e.phase, e.type, dim_string(e.dim))];
+    ++stats.calls;
+    stats.ms += e.duration / 1000.0;
+    stats.bytes += e.bytes;
+    stats.flops += e.flops;
+  }
+  return summary;
+}
+
+void Profiler::write_chrome_trace(ostream& os) const {
+  lock_guard<mutex> lk(m);
+  os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  os << setprecision(15);
+  for (size_t i = 0; i < events.size(); ++i) {
+    const ProfileEvent & e = events[i];
+    os << (i ? ",\n" : "\n")
+       << "{\"name\": \"" << json_escape(e.type) << "\", \"cat\": \"" << phase_name(e.phase) << "\", \"ph\": \"X\""
+       << ", \"ts\": " << e.start << ", \"dur\": " << e.duration
+       << ", \"pid\": 0, \"tid\": " << e.thread
+       << ", \"args\": {\"dim\": \"" << json_escape(dim_string(e.dim)) << "\", \"bytes\": " << e.bytes << ", \"flops\": " << e.flops << "}}";
+  }
+  os << "\n]}\n";
+}
+
+void Profiler::write_summary(ostream& os) const {
+  os << "phase\ttype\tdim\tcalls\tms\tbytes\tflops\n";
+  for (auto & kv : get_summary()) {
+    const ProfileStats & s = kv.second;
+    os << phase_name(get<0>(kv.first)) << '\t' << get<1>(kv.first) << '\t' << get<2>(kv.first) << '\t'
+       << s.calls << '\t' << s.ms << '\t' << s.bytes << '\t' << s.flops << '\n';
+  }
+}
+
+void Profiler::save(const string& prefix) const {
+  ofstream trace(prefix + ".trace.json");
+  if (!trace)
+    DYNET_RUNTIME_ERR("Could not write the profile to " << prefix << ".trace.json");
+  write_chrome_trace(trace);
+  ofstream summary(prefix + ".summary.tsv");
+  if (!summary)
+    DYNET_RUNTIME_ERR("Could not write the profile to " << prefix << ".summary.tsv");
+  write_summary(summary);
+}
+
+ProfileScope::~ProfileScope() {
+  if (node != nullptr)
+    profiler.record(node, phase, xs, fx, begin, chrono::steady_clock::now());
+}
+
+} // namespace dynet
@@ -0,0 +1,145 @@
+#ifndef DYNET_PROFILER_H
+#define DYNET_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "dynet/dim.h"
+
+namespace dynet {
+
+struct Node;
+struct Tensor;
+
+extern std::atomic<bool> profiling_flag;
+
+enum class ProfilePhase { forward, backward };
+
+/**
+ * \brief One execution of a node, as recorded by the Profiler
+ */
+struct ProfileEvent {
+  std::string type; /**< Name of the class of the node */
+  Dim dim; /**< Dimensions of the output of the node */
+  ProfilePhase phase; /**< Whether this is the forward or a backward computation */
+  unsigned thread; /**< Index of the thread that executed the node */
+  double start; /**< Start, in microseconds since the profiler was started */
+  double duration; /**< Duration in microseconds */
+  size_t bytes; /**< Bytes of memory that the output and auxiliary storage take */
+  double flops; /**< Estimate of the floating point operations executed */
+};
+
+/**
+ * \brief Totals of the executions of one type of node with one output dimension in one phase
+ */
+struct ProfileStats {
+  ProfileStats() : calls(0), ms(0), bytes(0), flops(0) {}
+  unsigned calls;
+  double ms;
+  size_t bytes;
+  double flops;
+};
+
+/**
+ * \brief Records the execution of every node while it is enabled
+ * \details Every call to Node::forward() and Node::backward() is recorded
+ *          with its node type, output dimensions, timing, memory and an
+ *          estimate of its floating point operations. The events can be
+ *          summarized per node type and dimension, or exported in the Chrome
+ *          trace format, which can be opened in chrome://tracing.
+ *          Profiling is turned on with --dynet-profiling PREFIX, in which case
+ *          the profile is saved when dynet::cleanup() is called, or with
+ *          start(). On GPUs, the times are those of launching the kernels.
+ *          At most max_events events are kept, later ones are only counted,
+ *          so long runs should call clear() after saving each profile.
+ */
+class Profiler {
+ public:
+  typedef std::chrono::steady_clock::time_point time_point;
+  typedef std::tuple<ProfilePhase, std::string, std::string> Key; // phase, type and dimensions
+
+  Profiler();
+
+  static const size_t default_max_events = 1 << 20;
+
+  /**
+   * \brief Clears the recorded events and starts recording
+   */
+  void start();
+  /**
+   * \brief Stops recording, the recorded events are kept
+   */
+  void stop();
+  bool is_enabled() const { return profiling_flag; }
+  /**
+   * \brief Discards the recorded events and restarts the clock, recording
+   *        continues if it was enabled
+   */
+  void clear();
+  /**
+   * \brief Sets the number of events that are kept; the events after that are dropped
+   */
+  void set_max_events(size_t n);
+  /**
+   * \brief Number of events dropped since the last clear() because max_events were recorded
+   */
+  size_t num_dropped() const;
+
+  void record(const Node* node, ProfilePhase phase, const std::vector<const Tensor*>& xs, const Tensor& fx, time_point begin, time_point end);
+
+  std::vector<ProfileEvent> get_events() const;
+  std::map<Key, ProfileStats> get_summary() const;
+
+  /**
+   * \brief Writes the events in the Chrome trace event format (JSON)
+   */
+  void write_chrome_trace(std::ostream& os) const;
+  /**
+   * \brief Writes the summary as tab-separated values, one line per phase,
+   *        node type and output dimensions, with a header line
+   */
+  void write_summary(std::ostream& os) const;
+  /**
+   * \brief Writes the trace to prefix.trace.json and the summary to prefix.summary.tsv
+   */
+  void save(const std::string& prefix) const;
+
+ private:
+  const std::string& type_name(const Node* node);
+  mutable std::mutex m;
+  time_point epoch;
+  std::vector<ProfileEvent> events;
+  size_t max_events, dropped;
+  std::unordered_map<std::type_index, std::string> type_names;
+};
+
+/**
+ * \brief Records the execution of a node from its creation to its destruction,
+ *        if profiling is enabled
+ */
+class ProfileScope {
+ public:
+  ProfileScope(const Node* node, ProfilePhase phase, const std::vector<const Tensor*>& xs, const Tensor& fx) :
+    node(profiling_flag ? node : nullptr), phase(phase), xs(xs), fx(fx) {
+    if (this->node != nullptr) begin = std::chrono::steady_clock::now();
+  }
+  ~ProfileScope();
+ private:
+  const Node* node;
+  ProfilePhase phase;
+  const std::vector<const Tensor*>& xs;
+  const Tensor& fx;
+  Profiler::time_point begin;
+};
+
+} // namespace dynet
+
+#endif
@@ -11,17 +11,60 @@ using namespace std;
 
 namespace dynet {
 
+// gives the memory of a tensor back to the parameter pool of its device
+static void free_shadow_tensor(Tensor& t) {
+  if (t.device != nullptr && t.mem_pool == DeviceMempool::PS)
+    t.device->free_tensor(DeviceMempool::PS, t);
+}
+
 ShadowParameters::ShadowParameters(const ParameterStorage& p) : h(p.values) {
   default_device->allocate_tensor(DeviceMempool::PS, h);
   TensorTools::zero(h);
 }
 
+ShadowParameters::ShadowParameters(ShadowParameters&& sp) : h(sp.h) {
+  sp.h.v = nullptr;
+}
+
+ShadowParameters& ShadowParameters::operator=(ShadowParameters&& sp) {
+  if (this != &sp) {
+    free_shadow_tensor(h);
+    h = sp.h;
+    sp.h.v = nullptr;
+  }
+  return *this;
+}
+
+ShadowParameters::~ShadowParameters() {
+  free_shadow_tensor(h);
+}
+
 ShadowLookupParameters::ShadowLookupParameters(const LookupParameterStorage& lp) : all_h(lp.all_values) {
   default_device->allocate_tensor(DeviceMempool::PS, all_h);
   TensorTools::zero(all_h);
   initialize_lookups();
 }
 
+ShadowLookupParameters::ShadowLookupParameters(ShadowLookupParameters&& slp) : all_h(slp.all_h), h(std::move(slp.h)) {
+  slp.all_h.v = nullptr;
+  slp.h.clear();
+}
+
+ShadowLookupParameters& ShadowLookupParameters::operator=(ShadowLookupParameters&& slp) {
+  if (this != &slp) {
+    free_shadow_tensor(all_h);
+    all_h = slp.all_h;
+    h = std::move(slp.h);
+    slp.all_h.v = nullptr;
+    slp.h.clear();
+  }
+  return *this;
+}
+
+ShadowLookupParameters::~ShadowLookupParameters() {
+  free_shadow_tensor(all_h);
+}
+
 void ShadowLookupParameters::initialize_lookups() {
   int num = all_h.d[all_h.d.nd-1];
   Dim dim = all_h.d; dim.nd--;
@@ -15,9 +15,14 @@ class Model;
 struct ParameterStorage;
 struct LookupParameterStorage;
 
+// The shadow values are allocated in the parameter memory, which they give
+// back when destroyed. They can be moved but not copied.
 struct ShadowParameters {
   ShadowParameters() {}
   explicit ShadowParameters(const ParameterStorage& p);
+  ShadowParameters(ShadowParameters&& sp);
+  ShadowParameters& operator=(ShadowParameters&& sp);
+  ~ShadowParameters();
   Tensor h;
  private:
   DYNET_SERIALIZE_DECLARE()
@@ -26,6 +31,9 @@ struct ShadowParameters {
 struct ShadowLookupParameters {
   ShadowLookupParameters() {}
   explicit ShadowLookupParameters(const LookupParameterStorage& lp);
+  ShadowLookupParameters(ShadowLookupParameters&& slp);
+  ShadowLookupParameters& operator=(ShadowLookupParameters&& slp);
+  ~ShadowLookupParameters();
   Tensor all_h;
   std::vector<Tensor> h;
  private:
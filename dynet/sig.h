@@ -5,6 +5,8 @@
 
 #include <unordered_map>
 #include <map>
+#include <vector>
+#include <cstring>
 
 namespace dynet {
 
@@ -12,7 +14,7 @@ namespace dynet {
     enum NodeType { 
       tanh=1, sqrt, abs, erf, square, cube, exp, loggamma, log, nobackprop, flipgradient, identity, negate, rectify, logistic, softsign,
       plus_const, concat, cmult, sum, squared_distance, softmax, pnls, pickrange, scalar_mult,
-      input, scalar_input, lookup, 
+      input, scalar_input, lookup, fused,
       COMPLEX,
       affine, matmul,
     };
@@ -102,6 +104,48 @@ inline bool operator!=(const SigHash& a, const SigHash& b) {
   return a.hash != b.hash;
 }
 
+// A signature that is hashed for lookup and compared exactly. The first
+// DYNET_MAX_SIG values are stored inline, longer signatures spill over.
+struct SigExact {
+  SigExact(int which) : which(which), hash((size_t)0xcc9e2d51 ^ (size_t)which), size(0) { }
+  SigExact() : which(0), hash((size_t)0xcc9e2d51), size(0) { }
+  // only the values that were added are copied
+  SigExact(const SigExact& s) : which(s.which), hash(s.hash), size(s.size), more(s.more) {
+    memcpy(data, s.data, inline_size() * sizeof(int));
+  }
+  SigExact& operator=(const SigExact& s) {
+    which = s.which; hash = s.hash; size = s.size; more = s.more;
+    memcpy(data, s.data, inline_size() * sizeof(int));
+    return *this;
+  }
+  unsigned inline_size() const { return size < DYNET_MAX_SIG ? size : DYNET_MAX_SIG; }
+  int which;
+  size_t hash;
+  unsigned size;
+  int data[DYNET_MAX_SIG];
+  std::vector<int> more;
+
+  // sdbm hash
+  inline void add_int(int i) {
+    hash = (size_t)i + (hash << 6) + (hash << 16) - hash;
+    if (size < DYNET_MAX_SIG) data[size] = i;
+    else more.push_back(i);
+    ++size;
+  }
+  void add_node(unsigned i) { add_int(-(int)i); }
+  void add_dim(const Dim &d) {
+    add_int(-(int)d.nd);
+    for(size_t i = 0; i < d.nd; ++i)
+      add_int((int)d.d[i]);
+  }
+};
+
+inline bool operator==(const SigExact& a, const SigExact& b) {
+  if(a.which != b.which || a.hash != b.hash || a.size != b.size) return false;
+  return memcmp(a.data, b.data, a.inline_size() * sizeof(int)) == 0 && a.more == b.more;
+}
+inline bool operator!=(const SigExact& a, const SigExact& b) { return !(a == b); }
+
 template <class Sig>
 struct SigLinearMap {
   SigLinearMap() { sigs.reserve(50); whiches.reserve(50); Sig s; sigs.push_back(s); whiches.push_back(s.which); }
@@ -167,6 +211,28 @@ struct SigHasher {
   size_t operator()(const SigHash& k) const { return k.hash; }
 };
 
+// Finds signatures through a hash index, and tells apart the signatures
+// whose hashes collide by comparing them exactly
+template <class Sig>
+struct SigIndexedMap {
+  SigIndexedMap() { sigs.reserve(50); whiches.reserve(50); Sig s; index.insert(std::make_pair(s.hash, 0)); sigs.push_back(s); whiches.push_back(s.which); }
+  int get_idx(Sig &s) {
+    auto range = index.equal_range(s.hash);
+    for (auto it = range.first; it != range.second; ++it)
+      if (sigs[it->second] == s)
+        return it->second;
+    index.insert(std::make_pair(s.hash, (int)sigs.size()));
+    sigs.push_back(s);
+    whiches.push_back(s.which);
+    return sigs.size()-1;
+  }
+  int sig2type(int sig) { return whiches[sig]; }
+  int size() { return sigs.size(); }
+  std::vector<Sig> sigs;
+  std::vector<int> whiches;
+  std::unordered_multimap<size_t, int> index;
+};
+
 template <class Sig>
 struct SigTreeMap {
   SigTreeMap() { }
@@ -193,9 +259,10 @@ struct SigHashMap {
   std::unordered_map<Sig, int, SigHasher> sigs;
 };
 
-typedef SigHash Sig;
+typedef SigExact Sig;
 //typedef SigLinearMap<Sig> SigMap;
-typedef SigLinearSortedMap<Sig> SigMap;
+//typedef SigLinearSortedMap<Sig> SigMap;
+typedef SigIndexedMap<Sig> SigMap;
 
 } // namespace dynet
 
@@ -0,0 +1,84 @@
+#ifndef DYNET_SMALL_VECTOR_H
+#define DYNET_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+
+namespace dynet {
+
+/**
+ * \brief A vector that stores up to N elements inline
+ * \details Only vectors longer than N allocate memory on the heap, so short
+ *          vectors, like the arguments of most nodes, cost no allocation.
+ *          T must be default constructible and copyable.
+ */
+template <class T, unsigned N>
+class SmallVector {
+ public:
+  typedef T value_type;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+  typedef size_t size_type;
+
+  SmallVector() : ptr(inline_data), n(0), cap(N) {}
+  SmallVector(std::initializer_list<T> l) : SmallVector() { assign(l.begin(), l.end()); }
+  template <class It>
+  SmallVector(It first, It last) : SmallVector() { assign(first, last); }
+  SmallVector(const SmallVector& v) : SmallVector() { assign(v.begin(), v.end()); }
+  SmallVector& operator=(const SmallVector& v) {
+    if (this != &v) assign(v.begin(), v.end());
+    return *this;
+  }
+  ~SmallVector() { if (ptr != inline_data) delete[] ptr; }
+
+  template <class It>
+  void assign(It first, It last) {
+    n = 0;
+    reserve(std::distance(first, last));
+    for (; first != last; ++first) ptr[n++] = *first;
+  }
+  void reserve(size_t c) {
+    if (c <= cap) return;
+    T* p = new T[c];
+    std::copy(ptr, ptr + n, p);
+    if (ptr != inline_data) delete[] ptr;
+    ptr = p;
+    cap = c;
+  }
+  void push_back(const T& x) {
+    if (n == cap) reserve(2 * cap);
+    ptr[n++] = x;
+  }
+  void resize(size_t s) {
+    reserve(s);
+    for (size_t i = n; i < s; ++i) ptr[i] = T();
+    n = s;
+  }
+  void clear() { n = 0; }
+
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  T& operator[](size_t i) { return ptr[i]; }
+  const T& operator[](size_t i) const { return ptr[i]; }
+  T& front() { return ptr[0]; }
+  const T& front() const { return ptr[0]; }
+  T& back() { return ptr[n - 1]; }
+  const T& back() const { return ptr[n - 1]; }
+  T* data() { return ptr; }
+  const T* data() const { return ptr; }
+  iterator begin() { return ptr; }
+  iterator end() { return ptr + n; }
+  const_iterator begin() const { return ptr; }
+  const_iterator end() const { return ptr + n; }
+
+ private:
+  T* ptr;
+  unsigned n, cap;
+  T inline_data[N];
+};
+
+} // namespace dynet
+
+#endif
@@ -396,7 +396,7 @@ IndexTensor TensorTools::argmax_dev(MyDevice & dev, const Tensor& v, unsigned di
   DYNET_ARG_CHECK(v.mem_pool != DeviceMempool::NONE, "Input Tensor to TensorTools::argmax must be associated with a memory pool.");
   Dim ids_dim = v.d; ids_dim.d[dim] = num;
   IndexTensor ids(ids_dim, nullptr, v.device, v.mem_pool);
-  AlignedMemoryPool* pool = v.device->pools[(size_t)v.mem_pool];
+  AlignedMemoryPool* pool = v.device->pool(v.mem_pool);
   ids.v = static_cast<Eigen::DenseIndex*>(pool->allocate(ids_dim.size() * sizeof(Eigen::DenseIndex)));
   ids.tb<3>().device(*dev.edevice) = v.tb<4>().argmax(dim);
   return ids;
@@ -427,7 +427,7 @@ IndexTensor TensorTools::categorical_sample_log_prob_dev(MyDevice & dev, const T
   DYNET_ARG_CHECK(v.mem_pool != DeviceMempool::NONE, "Input Tensor to TensorTools::argmax must be associated with a memory pool.");
   Dim ids_dim = v.d; ids_dim.d[dim] = num;
   IndexTensor ids(ids_dim, nullptr, v.device, v.mem_pool);
-  AlignedMemoryPool* pool = v.device->pools[(int)v.mem_pool];
+  AlignedMemoryPool* pool = v.device->pool(v.mem_pool);
   ids.v = static_cast<Eigen::DenseIndex*>(pool->allocate(ids_dim.size() * sizeof(Eigen::DenseIndex)));
   size_t used = pool->used();
   Dim copy_dim = v.d; // TODO: make this match num to enable num
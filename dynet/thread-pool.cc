@@ -0,0 +1,103 @@
+#include "dynet/thread-pool.h"
+
+using namespace std;
+
+namespace dynet {
+
+ThreadPool::ThreadPool(unsigned num_threads) : queues(num_threads > 0 ? num_threads : 1), current(nullptr), remaining(0), generation(0), stop(false) {
+  // participant 0 is the thread calling run()
+  for (unsigned i = 1; i < queues.size(); ++i)
+    workers.push_back(thread(&ThreadPool::worker_loop, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lk(wake_m);
+    stop = true;
+  }
+  wake_cv.notify_all();
+  for (auto & w : workers) w.join();
+}
+
+void ThreadPool::run(const vector<function<void()>>& tasks) {
+  lock_guard<mutex> run_lk(run_m);
+  if (tasks.size() == 0) return;
+  // not worth waking anybody up
+  if (tasks.size() == 1 || queues.size() == 1) {
+    for (auto & t : tasks) t();
+    return;
+  }
+  current = &tasks;
+  error = nullptr;
+  remaining = tasks.size();
+  for (unsigned i = 0; i < tasks.size(); ++i) {
+    TaskQueue & q = queues[i % queues.size()];
+    lock_guard<mutex> lk(q.m);
+    q.ids.push_back(i);
+  }
+  {
+    lock_guard<mutex> lk(wake_m);
+    ++generation;
+  }
+  wake_cv.notify_all();
+  work(0);
+  {
+    unique_lock<mutex> lk(wake_m);
+    done_cv.wait(lk, [this] { return remaining == 0; });
+  }
+  current = nullptr;
+  if (error) rethrow_exception(error);
+}
+
+bool ThreadPool::next_task(unsigned me, unsigned& id) {
+  {
+    TaskQueue & q = queues[me];
+    lock_guard<mutex> lk(q.m);
+    if (!q.ids.empty()) {
+      id = q.ids.back();
+      q.ids.pop_back();
+      return true;
+    }
+  }
+  for (unsigned k = 1; k < queues.size(); ++k) {
+    TaskQueue & q = queues[(me + k) % queues.size()];
+    lock_guard<mutex> lk(q.m);
+    if (!q.ids.empty()) {
+      id = q.ids.front();
+      q.ids.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(unsigned me) {
+  unsigned id;
+  while (next_task(me, id)) {
+    try {
+      (*current)[id]();
+    } catch (...) {
+      lock_guard<mutex> lk(error_m);
+      if (!error) error = current_exception();
+    }
+    if (--remaining == 0) {
+      lock_guard<mutex> lk(wake_m);
+      done_cv.notify_all();
+    }
+  }
+}
+
+void ThreadPool::worker_loop(unsigned me) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      unique_lock<mutex> lk(wake_m);
+      wake_cv.wait(lk, [&] { return stop || generation != seen; });
+      if (stop) return;
+      seen = generation;
+    }
+    work(me);
+  }
+}
+
+} // namespace dynet
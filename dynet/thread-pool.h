@@ -0,0 +1,59 @@
+#ifndef DYNET_THREAD_POOL_H
+#define DYNET_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dynet {
+
+/**
+ * \brief A small work-stealing thread pool
+ * \details Every participant (the calling thread plus num_threads-1 workers)
+ *          owns a deque of task indices. A participant pops work from the back
+ *          of its own deque and, once that is empty, steals from the front of
+ *          the deques of the others. run() blocks until every task is done and
+ *          rethrows the first exception raised by a task, if any.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(unsigned num_threads);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  void run(const std::vector<std::function<void()>>& tasks);
+  unsigned size() const { return queues.size(); }
+
+ private:
+  struct TaskQueue {
+    std::mutex m;
+    std::deque<unsigned> ids;
+  };
+
+  void work(unsigned me);
+  bool next_task(unsigned me, unsigned& id);
+  void worker_loop(unsigned me);
+
+  std::vector<TaskQueue> queues;
+  std::vector<std::thread> workers;
+  const std::vector<std::function<void()>>* current;
+  std::atomic<unsigned> remaining;
+  std::exception_ptr error;
+  std::mutex error_m;
+
+  std::mutex run_m; // only one run() at a time
+  std::mutex wake_m;
+  std::condition_variable wake_cv, done_cv;
+  unsigned long generation;
+  bool stop;
+};
+
+} // namespace dynet
+
+#endif
@@ -0,0 +1,71 @@
+#include "dynet/dynet.h"
+#include "dynet/expr.h"
+#include "dynet/init.h"
+#include "dynet/graph.h"
+#include "dynet/timing.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+using namespace dynet;
+using namespace dynet::expr;
+
+// Times the forward and backward passes of LSTM-style cell updates, a
+// typical chain of elementwise operations, with and without the fusion of
+// graph_optimize(), for several sizes of the hidden state. Usage:
+//   bench_fusion [repetitions] --dynet-mem 3000
+int main(int argc, char** argv) {
+  dynet::initialize(argc, argv);
+  const unsigned reps = (argc > 1 ? atoi(argv[1]) : 20);
+  const unsigned cells = 32;
+  cout << "dim\tfused\tinference\tforward_ms\tbackward_ms" << endl;
+  for (unsigned dim : {64u, 1024u, 4096u, 16384u, 262144u}) {
+    Model model;
+    vector<Parameter> gates;
+    for (unsigned k = 0; k < 5; ++k)
+      gates.push_back(model.add_parameters({dim}));
+    for (int inference = 0; inference < 2; ++inference) {
+      for (int fuse = 0; fuse < 2; ++fuse) {
+        double forward_ms = 0, backward_ms = 0;
+        for (unsigned r = 0; r <= reps; ++r) {
+          ComputationGraph cg;
+          cg.set_inference_mode(inference);
+          vector<Expression> g;
+          for (auto & p : gates)
+            g.push_back(parameter(cg, p));
+          vector<Expression> hs;
+          Expression c = g[4];
+          for (unsigned k = 0; k < cells; ++k) {
+            // a different scale in each cell, so that graph_optimize() has
+            // no common subexpressions to merge and only fuses
+            const float a = 1.f + 0.01f * k;
+            c = cmult(logistic(g[1] * a), c) + cmult(logistic(g[0] * a), tanh(g[3] * a));
+            hs.push_back(squared_norm(cmult(logistic(g[2] * a), tanh(c))));
+          }
+          Expression loss = sum(hs);
+          if (fuse)
+            graph_optimize(&cg);
+          Timing timer;
+          cg.forward(loss);
+          double f = timer.stop();
+          double b = 0;
+          if (!inference) {
+            timer.start();
+            cg.backward(loss);
+            b = timer.stop();
+          }
+          // the first repetition warms up memory
+          if (r > 0) {
+            forward_ms += f;
+            backward_ms += b;
+          }
+        }
+        cout << dim << '\t' << fuse << '\t' << inference << '\t' << fixed << setprecision(3)
+             << forward_ms / reps << '\t' << backward_ms / reps << endl;
+      }
+    }
+  }
+  return 0;
+}
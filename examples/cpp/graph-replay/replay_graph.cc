@@ -0,0 +1,65 @@
+#include "dynet/dynet.h"
+#include "dynet/expr.h"
+#include "dynet/init.h"
+#include "dynet/graph-record.h"
+#include "dynet/timing.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <thread>
+
+using namespace std;
+using namespace dynet;
+using namespace dynet::expr;
+
+// Rebuilds a graph recorded with dynet::record_graph() and
+// dynet::save_recorded_graph() with random data, and times its forward and
+// backward passes with every execution engine and autobatching strategy.
+int main(int argc, char** argv) {
+  dynet::initialize(argc, argv);
+  if (argc != 2 && argc != 3) {
+    cerr << "Usage: " << argv[0] << " graph.txt [repetitions]\n";
+    return 1;
+  }
+  ifstream in(argv[1]);
+  if (!in) {
+    cerr << "Could not open " << argv[1] << endl;
+    return 1;
+  }
+  const RecordedGraph g = load_recorded_graph(in);
+  const unsigned reps = (argc == 3 ? atoi(argv[2]) : 10);
+  GraphReplayer replayer(g);
+
+  // autobatching strategy and number of execution threads
+  const unsigned hw_threads = max(2u, thread::hardware_concurrency());
+  vector<pair<int, int> > configs = {{0, 1}, {0, (int)hw_threads}, {1, 1}, {2, 1}, {3, 1}, {4, 1}};
+  cout << g.nodes.size() << " nodes, " << g.params.size() << " parameters, " << reps << " repetitions" << endl;
+  cout << "autobatch\tthreads\tforward_ms\tbackward_ms" << endl;
+  for (auto & config : configs) {
+    autobatch_flag = config.first;
+    exec_threads_flag = config.second;
+    double forward_ms = 0, backward_ms = 0;
+    for (unsigned r = 0; r <= reps; ++r) {
+      ComputationGraph cg;
+      Expression loss = replayer.build(cg);
+      Timing timer;
+      cg.forward(loss);
+      double f = timer.stop();
+      timer.start();
+      cg.backward(loss);
+      double b = timer.stop();
+      // the first repetition warms up memory and autobatching plans
+      if (r > 0) {
+        forward_ms += f;
+        backward_ms += b;
+      }
+    }
+    cout << config.first << '\t' << config.second << '\t' << fixed << setprecision(3)
+         << forward_ms / reps << '\t' << backward_ms / reps << endl;
+  }
+  if (replayer.num_stand_ins() > 0)
+    cout << replayer.num_stand_ins() << " nodes could not be rebuilt and were replaced by inputs" << endl;
+  return 0;
+}
@@ -31,3 +31,32 @@ BOOST_AUTO_TEST_CASE( aligned_allocator ) {
   a.free(mem);
 }
 
+
+BOOST_AUTO_TEST_CASE( node_arena ) {
+  dynet::NodeArena arena(256);
+  void* a = arena.allocate(10, 1);
+  void* b = arena.allocate(16, 16);
+  BOOST_CHECK_EQUAL(((uintptr_t)(b) & 0xf), 0);
+  BOOST_CHECK((char*)b >= (char*)a + 10);
+  arena.allocate(1000, 8);
+  const size_t capacity = arena.capacity();
+  arena.reset();
+  BOOST_CHECK(arena.allocate(10, 1) == a);
+  arena.allocate(16, 16);
+  arena.allocate(1000, 8);
+  BOOST_CHECK_EQUAL(arena.capacity(), capacity);
+}
+
+BOOST_AUTO_TEST_CASE( small_vector ) {
+  dynet::SmallVector<unsigned, 2> v = {1, 2};
+  BOOST_CHECK_EQUAL(v.size(), 2);
+  v.push_back(3);
+  dynet::SmallVector<unsigned, 2> w(v);
+  v[0] = 0;
+  BOOST_CHECK_EQUAL(w.size(), 3);
+  BOOST_CHECK_EQUAL(w[0], 1);
+  BOOST_CHECK_EQUAL(w.back(), 3);
+  w = dynet::SmallVector<unsigned, 2>{4};
+  BOOST_CHECK_EQUAL(w.size(), 1);
+  BOOST_CHECK_EQUAL(w[0], 4);
+}
@@ -7,10 +7,18 @@
 #include <dynet/fast-lstm.h>
 #include <dynet/gru.h>
 #include <dynet/grad-check.h>
+#include <dynet/profiler.h>
+#include <dynet/graph.h>
+#include <dynet/graph-record.h>
+#include <dynet/pipeline.h>
+#include <dynet/training.h>
+#include <dynet/globals.h>
 #include <boost/test/unit_test.hpp>
 #include "test.h"
 #include <stdexcept>
 #include <fstream>
+#include <thread>
+#include <mutex>
 
 using namespace dynet;
 using namespace dynet::expr;
@@ -55,8 +63,9 @@ BOOST_AUTO_TEST_CASE( autobatch_lstm_gradient ) {
   dynet::Model mod;
   dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
   dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
-  for(size_t i = 0; i < 3; ++i) {
-    dynet::autobatch_flag = i;
+  // strategy 4 runs twice, once to measure and once using the measurements
+  for(int strategy : {0, 1, 2, 4, 4}) {
+    dynet::autobatch_flag = strategy;
     dynet::ComputationGraph cg;
     lstm.new_graph(cg);
     vector<Expression> losses;
@@ -77,5 +86,639 @@ BOOST_AUTO_TEST_CASE( autobatch_lstm_gradient ) {
     BOOST_CHECK_CLOSE(results[0], results[i], 0.0001);
 }
 
+BOOST_AUTO_TEST_CASE( signatures_with_colliding_hashes ) {
+  SigMap sigmap;
+  Sig a(nt::tanh), b(nt::tanh), c(nt::tanh);
+  a.add_node(1);
+  b.add_node(2);
+  c.add_node(1);
+  // the hashes collide, but the signatures are told apart by their values
+  b.hash = a.hash;
+  const int ia = sigmap.get_idx(a), ib = sigmap.get_idx(b);
+  BOOST_CHECK_NE(ia, ib);
+  BOOST_CHECK_EQUAL(sigmap.get_idx(c), ia);
+  BOOST_CHECK_EQUAL(sigmap.get_idx(b), ib);
+}
+
+BOOST_AUTO_TEST_CASE( autobatch_plan_reuse ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  // the second and third graph have the same structure as the first, so
+  // they reuse its schedule, but the inputs differ
+  for(size_t r = 0; r < 3; ++r) {
+    vector<float> results;
+    for(size_t i = 0; i < 2; ++i) {
+      dynet::autobatch_flag = i;
+      dynet::ComputationGraph cg;
+      lstm.new_graph(cg);
+      vector<Expression> losses;
+      for(size_t j = 0; j < 3; ++j) {
+        lstm.start_new_sequence();
+        for(size_t k = 0; k < 3; ++k)
+          lstm.add_input(dynet::lookup(cg, lp, (j*3 + k + r) % 10));
+        losses.push_back(squared_norm(lstm.final_h()[1]));
+      }
+      Expression z = dynet::sum(losses);
+      size_t reuses = dynet::BatchedExecutionEngine::num_plan_reuses();
+      results.push_back(as_scalar(z.value()));
+      if(i == 1 && r > 0)
+        BOOST_CHECK_GT(dynet::BatchedExecutionEngine::num_plan_reuses(), reuses);
+      BOOST_CHECK(check_grad(mod, z, 0));
+    }
+    BOOST_CHECK_CLOSE(results[0], results[1], 0.0001);
+  }
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( autobatch_incremental_decoding ) {
+  dynet::Model mod;
+  dynet::Parameter p_W = mod.add_parameters({3, 3});
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  vector<vector<float> > results;
+  // each step of the decoding adds the same nodes for all the hypotheses, and
+  // is evaluated incrementally, so steps after the first reuse its schedule
+  for(int strategy : {0, 1, 2, 3, 4}) {
+    dynet::autobatch_flag = strategy;
+    dynet::ComputationGraph cg;
+    Expression W = parameter(cg, p_W);
+    vector<Expression> hs;
+    // more kinds of nodes in the graph than new nodes in any step
+    for(size_t b = 0; b < 3; ++b)
+      hs.push_back(softmax(logistic(rectify(cube(square(lookup(cg, lp, b)))))));
+    // the initial states are evaluated on their own, so that the first step
+    // only holds the nodes that every step adds
+    hs.back().value();
+    results.push_back(vector<float>());
+    for(size_t t = 0; t < 4; ++t) {
+      vector<Expression> scores;
+      for(size_t b = 0; b < hs.size(); ++b) {
+        hs[b] = tanh(W * hs[b] + lookup(cg, lp, (t*3 + b) % 10));
+        scores.push_back(squared_norm(hs[b]));
+      }
+      size_t reuses = dynet::BatchedExecutionEngine::num_plan_reuses();
+      for(auto & score : scores)
+        results.back().push_back(as_scalar(score.value()));
+      if(t > 0 && strategy >= 1 && strategy <= 3)
+        BOOST_CHECK_GT(dynet::BatchedExecutionEngine::num_plan_reuses(), reuses);
+    }
+  }
+  for(size_t i = 1; i < results.size(); ++i)
+    for(size_t j = 0; j < results[0].size(); ++j)
+      BOOST_CHECK_CLOSE(results[0][j], results[i][j], 0.0001);
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( autobatch_contiguous_arguments ) {
+  dynet::Model mod;
+  vector<dynet::Parameter> ps;
+  for(size_t k = 0; k < 4; ++k)
+    ps.push_back(mod.add_parameters({3}));
+  vector<float> results;
+  for(int strategy : {0, 1, 2}) {
+    dynet::autobatch_flag = strategy;
+    dynet::ComputationGraph cg;
+    vector<Expression> xs, ys;
+    for(auto & p : ps) {
+      xs.push_back(parameter(cg, p));
+      ys.push_back(squared_norm(tanh(xs.back())));
+    }
+    Expression z = dynet::sum(ys);
+    results.push_back(as_scalar(z.value()));
+    // the arguments of the batched tanh are laid out back to back
+    if(strategy != 0)
+      for(size_t k = 1; k < xs.size(); ++k)
+        BOOST_CHECK_EQUAL(xs[k].value().v, xs[k-1].value().v + 3);
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  for(size_t i = 1; i < results.size(); ++i)
+    BOOST_CHECK_CLOSE(results[0], results[i], 0.0001);
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( autobatch_fused_elementwise ) {
+  dynet::Model mod;
+  vector<Parameter> ps;
+  for(size_t k = 0; k < 4; ++k)
+    ps.push_back(mod.add_parameters({3}));
+  vector<float> results;
+  for(int strategy : {0, 1, 2}) {
+    dynet::autobatch_flag = strategy;
+    dynet::ComputationGraph cg;
+    vector<Expression> ys;
+    for(auto & p : ps)
+      ys.push_back(squared_norm(tanh(parameter(cg, p) * 0.5f + 1.f)));
+    Expression z = dynet::sum(ys);
+    graph_optimize(&cg);
+    profiler.start();
+    results.push_back(as_scalar(z.value()));
+    profiler.stop();
+    // the four identical fused chains run as one batch when autobatching
+    unsigned calls = 0;
+    for(auto & event : profiler.get_events())
+      calls += (event.type == "FusedElementwise");
+    BOOST_CHECK_EQUAL(calls, strategy == 0 ? 4 : 1);
+    profiler.clear();
+    BOOST_CHECK(check_grad(mod, z, 0));
+    // the nodes that were fused away get no gradient memory
+    cg.backward(z);
+    size_t live = 0;
+    for(auto node : cg.nodes)
+      if(node->has_value())
+        live += default_device->mem->round_up_align(node->dim.size() * sizeof(float));
+    BOOST_CHECK_LE(default_device->pool(DeviceMempool::DEDFS)->used(), live);
+  }
+  for(size_t i = 1; i < results.size(); ++i)
+    BOOST_CHECK_CLOSE(results[0], results[i], 0.0001);
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( autobatch_parameter_gradients ) {
+  dynet::Model mod;
+  dynet::Parameter p = mod.add_parameters({3});
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  for(int strategy : {0, 1, 2}) {
+    dynet::autobatch_flag = strategy;
+    dynet::ComputationGraph cg;
+    // repeated parameter nodes, and lookups of repeated rows
+    vector<Expression> ys;
+    for(unsigned k = 0; k < 6; ++k)
+      ys.push_back(squared_norm(parameter(cg, p) + lookup(cg, lp, k % 4)));
+    Expression z = dynet::sum(ys);
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( autobatch_const_lookup_gradients ) {
+  dynet::Model mod;
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  for(int strategy : {1, 2}) {
+    dynet::autobatch_flag = strategy;
+    vector<vector<float> > before;
+    for(unsigned k = 0; k < 10; ++k)
+      before.push_back(as_vector(lp.get()->values[k]));
+    dynet::SimpleSGDTrainer trainer(mod);
+    {
+      dynet::ComputationGraph cg;
+      // rows 0-2 are updated, rows 5-7 are frozen, all in one lookup batch
+      vector<Expression> ys;
+      for(unsigned k = 0; k < 3; ++k) {
+        ys.push_back(squared_norm(lookup(cg, lp, k)));
+        ys.push_back(squared_norm(const_lookup(cg, lp, k + 5)));
+      }
+      Expression z = dynet::sum(ys);
+      cg.forward(z);
+      cg.backward(z);
+      trainer.update(0.1);
+    }
+    for(unsigned k = 0; k < 3; ++k)
+      BOOST_CHECK(as_vector(lp.get()->values[k]) != before[k]);
+    for(unsigned k = 5; k < 8; ++k)
+      BOOST_CHECK(as_vector(lp.get()->values[k]) == before[k]);
+  }
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( inference_mode_recycling ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  for(size_t i = 0; i < 2; ++i) {
+    dynet::autobatch_flag = i;
+    vector<float> results;
+    vector<size_t> used;
+    for(size_t inference = 0; inference < 2; ++inference) {
+      dynet::ComputationGraph cg;
+      cg.set_inference_mode(inference);
+      lstm.new_graph(cg);
+      lstm.start_new_sequence();
+      for(size_t k = 0; k < 50; ++k)
+        lstm.add_input(dynet::lookup(cg, lp, k % 10));
+      Expression z = squared_norm(lstm.final_h()[1]);
+      results.push_back(as_scalar(z.value()));
+      used.push_back(default_device->pool(DeviceMempool::FXS)->used());
+      if(inference)
+        BOOST_CHECK_THROW(cg.backward(z), std::runtime_error);
+    }
+    BOOST_CHECK_CLOSE(results[0], results[1], 0.0001);
+    BOOST_CHECK_LT(used[1], used[0]);
+  }
+  dynet::autobatch_flag = 0;
+}
+
+BOOST_AUTO_TEST_CASE( inference_mode_dropout ) {
+  dynet::Model mod;
+  dynet::Parameter p = mod.add_parameters({20});
+  dynet::ComputationGraph cg;
+  cg.set_inference_mode(true);
+  Expression x = parameter(cg, p);
+  vector<Expression> ys = {dropout(x, 0.5f), dropout_batch(x, 0.5f), block_dropout(x, 0.5f), noise(x, 1.f)};
+  Expression z = sum_elems(sum(ys) - 4 * x);
+  BOOST_CHECK_CLOSE(as_scalar(z.value()) + 1.f, 1.f, 0.0001);
+  for(auto & y : ys)
+    BOOST_CHECK_EQUAL(cg.nodes[y.i]->aux_storage_size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( recompute_lstm_gradient ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  dynet::autobatch_flag = 0;
+  vector<float> results;
+  vector<size_t> used;
+  // no recomputation, automatic segments, and one segment per input
+  for(size_t mode = 0; mode < 3; ++mode) {
+    dynet::ComputationGraph cg;
+    cg.set_recompute(mode == 1);
+    lstm.new_graph(cg);
+    lstm.start_new_sequence();
+    for(size_t k = 0; k < 30; ++k) {
+      if(mode == 2) cg.mark_recompute_segment();
+      lstm.add_input(dynet::lookup(cg, lp, k % 10));
+    }
+    Expression z = squared_norm(lstm.final_h()[1]);
+    results.push_back(as_scalar(z.value()));
+    used.push_back(default_device->pool(DeviceMempool::FXS)->used());
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  for(size_t i = 1; i < results.size(); ++i) {
+    BOOST_CHECK_CLOSE(results[0], results[i], 0.0001);
+    BOOST_CHECK_LT(used[i], used[0]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( demand_driven_forward ) {
+  dynet::Model mod;
+  dynet::Parameter p = mod.add_parameters({3});
+  dynet::autobatch_flag = 0;
+  for(int threads = 1; threads <= 2; ++threads) {
+    dynet::exec_threads_flag = threads;
+    dynet::ComputationGraph cg;
+    float x = 1.f;
+    Expression unused = input(cg, &x) * 3.f;
+    Expression z = sum_elems(parameter(cg, p));
+    z.value();
+    // nodes that z does not depend on are only computed when requested
+    x = 5.f;
+    BOOST_CHECK_CLOSE(as_scalar(unused.value()), 15.f, 0.0001);
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  dynet::exec_threads_flag = 1;
+}
+
+BOOST_AUTO_TEST_CASE( demand_driven_inference ) {
+  dynet::Model mod;
+  dynet::Parameter p = mod.add_parameters({1000});
+  float expected = 0.f;
+  for(float v : as_vector(p.get()->values))
+    expected += 2.f * tanh(v);
+  dynet::autobatch_flag = 0;
+  for(int threads = 1; threads <= 2; ++threads) {
+    dynet::exec_threads_flag = threads;
+    vector<size_t> used;
+    for(size_t with_side = 0; with_side < 2; ++with_side) {
+      dynet::ComputationGraph cg;
+      cg.set_inference_mode(true);
+      Expression h = tanh(parameter(cg, p));
+      Expression side;
+      if(with_side)
+        side = sum_elems(h * 2.f);
+      Expression z = sum_elems(tanh(h) + 1.f);
+      z.value();
+      used.push_back(default_device->pool(DeviceMempool::FXS)->used());
+      // the pending side branch does not keep h from being recycled, and
+      // computes it again when requested
+      if(with_side)
+        BOOST_CHECK_CLOSE(as_scalar(side.value()), expected, 0.001);
+    }
+    BOOST_CHECK_EQUAL(used[0], used[1]);
+    // values are recycled along the chain, so the memory in use stays
+    // well below that of all the values of the graph
+    BOOST_CHECK_LT(used[0], 3 * 1000 * sizeof(float));
+  }
+  dynet::exec_threads_flag = 1;
+}
+
+BOOST_AUTO_TEST_CASE( planned_memory_layout ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(1, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  dynet::autobatch_flag = 0;
+  for(int threads = 1; threads <= 2; ++threads) {
+    dynet::exec_threads_flag = threads;
+    dynet::ComputationGraph cg;
+    lstm.new_graph(cg);
+    lstm.start_new_sequence();
+    for(size_t k = 0; k < 5; ++k)
+      lstm.add_input(dynet::lookup(cg, lp, k));
+    Expression z = squared_norm(lstm.final_h()[0]);
+    z.value();
+    // the values are laid out one after the other in node order
+    size_t expected = 0;
+    for(size_t i = 0; i < cg.nodes.size(); ++i) {
+      const Tensor & t = cg.get_value((VariableIndex)i);
+      BOOST_CHECK_EQUAL((void*)t.v, (void*)((char*)cg.get_value((VariableIndex)0).v + expected));
+      expected += default_device->mem->round_up_align(cg.nodes[i]->dim.size() * sizeof(float));
+      expected += default_device->mem->round_up_align(cg.nodes[i]->aux_storage_size());
+    }
+    BOOST_CHECK_EQUAL(default_device->pool(DeviceMempool::FXS)->used(), expected);
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  dynet::exec_threads_flag = 1;
+}
+
+BOOST_AUTO_TEST_CASE( backward_needed_gradients ) {
+  dynet::Model mod;
+  dynet::Parameter p = mod.add_parameters({100});
+  dynet::autobatch_flag = 0;
+  for(int threads = 1; threads <= 2; ++threads) {
+    dynet::exec_threads_flag = threads;
+    dynet::ComputationGraph cg;
+    Expression x = parameter(cg, p);
+    Expression c = input(cg, {100}, vector<float>(100, 1.f));
+    // a branch the loss does not depend on, and a constant one
+    Expression unused = tanh(x);
+    Expression constant = tanh(c);
+    Expression y = x + constant;
+    Expression z = squared_norm(y);
+    cg.forward(z);
+    cg.backward(z);
+    // only the gradients of x and y get memory
+    const size_t size = default_device->mem->round_up_align(100 * sizeof(float));
+    BOOST_CHECK_EQUAL(default_device->pool(DeviceMempool::DEDFS)->used(), 2 * size);
+    vector<float> dy = as_vector(y.gradient()), dx = as_vector(x.gradient());
+    vector<float> vy = as_vector(y.value());
+    for(size_t i = 0; i < dy.size(); ++i) {
+      BOOST_CHECK_CLOSE(dy[i], 2 * vy[i], 0.0001);
+      BOOST_CHECK_CLOSE(dx[i], dy[i], 0.0001);
+    }
+    // gradients that were not computed are zero
+    for(float g : as_vector(constant.gradient()))
+      BOOST_CHECK_EQUAL(g, 0.f);
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  dynet::exec_threads_flag = 1;
+}
+
+BOOST_AUTO_TEST_CASE( rerun_static_graph ) {
+  dynet::Model mod;
+  dynet::Parameter pW = mod.add_parameters({2, 3});
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  // autobatching strategy and number of threads
+  for(auto config : vector<pair<int, int> >{{0, 1}, {0, 2}, {1, 1}}) {
+    dynet::autobatch_flag = config.first;
+    dynet::exec_threads_flag = config.second;
+    // builds the graph for the indices and input values
+    auto build = [&](dynet::ComputationGraph& cg, const unsigned* indices, const vector<float>* values, Expression& x) {
+      x = input(cg, {3}, values);
+      Expression W = parameter(cg, pW);
+      vector<Expression> losses;
+      for(size_t k = 0; k < 3; ++k)
+        losses.push_back(squared_norm(tanh(W * (lookup(cg, lp, indices + k) + x))));
+      return sum(losses);
+    };
+    unsigned indices[3] = {0, 1, 2};
+    vector<float> values = {0.1f, -0.2f, 0.3f};
+    float rerun_value;
+    vector<float> rerun_grad;
+    {
+      dynet::ComputationGraph cg;
+      Expression x;
+      Expression z = build(cg, indices, &values, x);
+      cg.forward(z);
+      const size_t used = default_device->pool(DeviceMempool::FXS)->used();
+      indices[0] = 5; indices[2] = 9;
+      values = {-0.5f, 0.4f, 0.0f};
+      rerun_value = as_scalar(cg.rerun(z));
+      BOOST_CHECK_EQUAL(default_device->pool(DeviceMempool::FXS)->used(), used);
+      cg.backward(z, true);
+      rerun_grad = as_vector(cg.get_gradient(x));
+    }
+    // a graph built for the new data gives the same results
+    dynet::ComputationGraph cg;
+    Expression x;
+    Expression z = build(cg, indices, &values, x);
+    BOOST_CHECK_CLOSE(rerun_value, as_scalar(cg.forward(z)), 1e-4);
+    cg.backward(z, true);
+    vector<float> grad = as_vector(cg.get_gradient(x));
+    for(size_t i = 0; i < grad.size(); ++i)
+      BOOST_CHECK_CLOSE(rerun_grad[i], grad[i], 1e-3);
+  }
+  dynet::autobatch_flag = 0;
+  dynet::exec_threads_flag = 1;
+}
+
+BOOST_AUTO_TEST_CASE( profiler_summary ) {
+  dynet::Model mod;
+  dynet::Parameter p = mod.add_parameters({4, 3});
+  dynet::autobatch_flag = 0;
+  dynet::ComputationGraph cg;
+  vector<float> x_values = {1.f, 2.f, 3.f};
+  Expression x = input(cg, {3}, x_values);
+  Expression z = squared_norm(parameter(cg, p) * x);
+  profiler.start();
+  z.value();
+  cg.backward(z);
+  profiler.stop();
+  auto summary = profiler.get_summary();
+  auto it = summary.find(Profiler::Key(ProfilePhase::forward, "MatrixMultiply", "{4}"));
+  BOOST_REQUIRE(it != summary.end());
+  BOOST_CHECK_EQUAL(it->second.calls, 1);
+  BOOST_CHECK_EQUAL(it->second.bytes, 4 * sizeof(float));
+  BOOST_CHECK_CLOSE(it->second.flops, 24.0, 0.0001);
+  BOOST_CHECK(summary.count(Profiler::Key(ProfilePhase::backward, "MatrixMultiply", "{4}")));
+  // nothing is recorded once the profiler is stopped
+  size_t num_events = profiler.get_events().size();
+  z.value();
+  cg.forward(z);
+  BOOST_CHECK_EQUAL(profiler.get_events().size(), num_events);
+  ostringstream trace;
+  profiler.write_chrome_trace(trace);
+  BOOST_CHECK(trace.str().find("\"name\": \"MatrixMultiply\"") != string::npos);
+  // events beyond the limit are only counted
+  size_t num_forward = 0;
+  for(auto & event : profiler.get_events())
+    num_forward += (event.phase == ProfilePhase::forward);
+  profiler.set_max_events(2);
+  profiler.start();
+  cg.forward(z);
+  profiler.stop();
+  BOOST_CHECK_EQUAL(profiler.get_events().size(), 2);
+  BOOST_CHECK_EQUAL(profiler.num_dropped(), num_forward - 2);
+  profiler.set_max_events(Profiler::default_max_events);
+  profiler.clear();
+  BOOST_CHECK_EQUAL(profiler.num_dropped(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( record_and_replay_graph ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(1, 3, 5, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  dynet::autobatch_flag = 0;
+  stringstream ss;
+  size_t num_nodes;
+  {
+    dynet::ComputationGraph cg;
+    lstm.new_graph(cg);
+    lstm.start_new_sequence();
+    for(unsigned k = 0; k < 3; ++k)
+      lstm.add_input(dynet::lookup(cg, lp, k));
+    squared_norm(lstm.back());
+    num_nodes = cg.nodes.size();
+    save_recorded_graph(ss, record_graph(cg));
+  }
+  RecordedGraph g = load_recorded_graph(ss);
+  BOOST_CHECK_EQUAL(g.nodes.size(), num_nodes);
+  BOOST_CHECK_EQUAL(g.params.size(), mod.parameters_list().size() + 1);
+  GraphReplayer replayer(g);
+  dynet::ComputationGraph cg;
+  Expression loss = replayer.build(cg);
+  BOOST_CHECK_EQUAL(replayer.num_stand_ins(), 0);
+  BOOST_REQUIRE_EQUAL(cg.nodes.size(), num_nodes);
+  for(size_t i = 0; i < num_nodes; ++i) {
+    BOOST_CHECK_EQUAL(cg.nodes[i]->type_name(), g.nodes[i].type);
+    BOOST_CHECK_EQUAL(cg.nodes[i]->dim, g.nodes[i].dim);
+  }
+  loss.value();
+  cg.backward(loss);
+}
+
+BOOST_AUTO_TEST_CASE( graphs_in_threads ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  dynet::autobatch_flag = 0;
+  auto run = [&](unsigned start, float& result) {
+    dynet::VanillaLSTMBuilder my_lstm(lstm);
+    for(size_t rep = 0; rep < 5; ++rep) {
+      dynet::ComputationGraph cg;
+      cg.set_inference_mode(true);
+      my_lstm.new_graph(cg);
+      my_lstm.start_new_sequence();
+      for(size_t k = 0; k < 20; ++k)
+        my_lstm.add_input(dynet::lookup(cg, lp, (start + k) % 10));
+      result = as_scalar(squared_norm(my_lstm.final_h()[1]).value());
+    }
+  };
+  vector<float> expected(4), results(4);
+  for(unsigned t = 0; t < 4; ++t)
+    run(t, expected[t]);
+  // a graph on this thread is alive while the others run
+  dynet::ComputationGraph main_cg;
+  vector<thread> threads;
+  for(unsigned t = 0; t < 4; ++t)
+    threads.push_back(thread(run, t, std::ref(results[t])));
+  for(auto & th : threads)
+    th.join();
+  for(unsigned t = 0; t < 4; ++t)
+    BOOST_CHECK_CLOSE(expected[t], results[t], 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE( parallel_graphs_in_threads ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  dynet::autobatch_flag = 0;
+  // the graphs of the threads run at the same time with different numbers
+  // of threads, so none of them may take down the pool of another
+  mutex flag_mutex;
+  auto run = [&](unsigned num_threads, float& result) {
+    dynet::VanillaLSTMBuilder my_lstm(lstm);
+    for(size_t rep = 0; rep < 5; ++rep) {
+      unique_lock<mutex> lk(flag_mutex);
+      dynet::exec_threads_flag = num_threads;
+      dynet::ComputationGraph cg;
+      lk.unlock();
+      cg.set_inference_mode(true);
+      my_lstm.new_graph(cg);
+      for(size_t j = 0; j < 3; ++j) {
+        my_lstm.start_new_sequence();
+        for(size_t k = 0; k < 10; ++k)
+          my_lstm.add_input(dynet::lookup(cg, lp, (j + k) % 10));
+      }
+      result = as_scalar(squared_norm(my_lstm.final_h()[1]).value());
+    }
+  };
+  vector<float> results(4);
+  vector<thread> threads;
+  for(unsigned t = 0; t < 4; ++t)
+    threads.push_back(thread(run, t + 2, std::ref(results[t])));
+  for(auto & th : threads)
+    th.join();
+  dynet::exec_threads_flag = 1;
+  for(unsigned t = 1; t < 4; ++t)
+    BOOST_CHECK_CLOSE(results[0], results[t], 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE( pipelined_training ) {
+  dynet::autobatch_flag = 0;
+  // training on the examples in order, with or without a pipeline
+  auto train = [](bool pipelined) {
+    dynet::Model mod;
+    dynet::Parameter pW = mod.add_parameters({1, 3}, ParameterInitConst(0.1f));
+    dynet::SimpleSGDTrainer trainer(mod);
+    auto build = [&](dynet::ComputationGraph& cg, unsigned k) {
+      Expression x = input(cg, {3}, {(float)k, 1.f, -(float)k});
+      return squared_norm(parameter(cg, pW) * x - input(cg, (float)k));
+    };
+    auto step = [&trainer](dynet::ComputationGraph& cg, Expression loss) {
+      cg.forward(loss);
+      cg.backward(loss);
+      trainer.update();
+    };
+    if (pipelined) {
+      dynet::GraphPipeline pipeline;
+      for(unsigned k = 0; k < 10; ++k) {
+        dynet::ComputationGraph& cg = pipeline.new_graph();
+        Expression loss = build(cg, k % 4);
+        pipeline.submit([&step, loss](dynet::ComputationGraph& cg) { step(cg, loss); });
+      }
+      pipeline.wait();
+    } else {
+      for(unsigned k = 0; k < 10; ++k) {
+        dynet::ComputationGraph cg;
+        step(cg, build(cg, k % 4));
+      }
+    }
+    return as_vector(*pW.values());
+  };
+  vector<float> expected = train(false), results = train(true);
+  for(size_t i = 0; i < expected.size(); ++i)
+    BOOST_CHECK_CLOSE(expected[i], results[i], 0.0001);
+  // the graph of this thread can be created again after the pipeline
+  dynet::ComputationGraph cg;
+  Expression x = input(cg, 1.f);
+  BOOST_CHECK_EQUAL(as_scalar(x.value()), 1.f);
+}
+
+BOOST_AUTO_TEST_CASE( parallel_lstm_gradient ) {
+  vector<float> results;
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod);
+  dynet::LookupParameter lp = mod.add_lookup_parameters(10, {3});
+  dynet::autobatch_flag = 0;
+  for(int i = 1; i <= 4; i *= 2) {
+    dynet::exec_threads_flag = i;
+    dynet::ComputationGraph cg;
+    lstm.new_graph(cg);
+    vector<Expression> losses;
+    for(size_t j = 0; j < 3; ++j) {
+      lstm.start_new_sequence();
+      for(size_t k = 0; k < 3; ++k) {
+        Expression x = dynet::lookup(cg, lp, j*3 + k);
+        lstm.add_input(x);
+      }
+      losses.push_back(squared_norm(lstm.final_h()[1]));
+    }
+    losses.push_back(losses[0] + losses[2]);
+    Expression z = dynet::sum(losses);
+    results.push_back(as_scalar(z.value()));
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  dynet::exec_threads_flag = 1;
+  for(size_t i = 1; i < results.size(); ++i)
+    BOOST_CHECK_EQUAL(results[0], results[i]);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,9 @@
 
 #include <dynet/dynet.h>
 #include <dynet/expr.h>
+#include <dynet/devices.h>
+#include <dynet/globals.h>
+#include <dynet/mem-stats.h>
 #include <dynet/training.h>
 #include <dynet/grad-check.h>
 #include <boost/test/unit_test.hpp>
@@ -46,4 +49,153 @@ BOOST_AUTO_TEST_CASE( expand_test ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( grow_with_checkpoint ) {
+  dynet::Model mod;
+  dynet::Parameter param = mod.add_parameters({512,512});
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param);
+  Expression y = squared_norm(x);
+  const float y_value = as_scalar(y.value());
+  AlignedMemoryPool* fxs = default_device->pool(DeviceMempool::FXS);
+  vector<float> results;
+  for (size_t i = 0; i < 2; ++i) {
+    cg.checkpoint();
+    const size_t used = fxs->used();
+    // the forward memory grows to hold these values
+    Expression z = squared_norm(tanh(x) + tanh(-x) + x);
+    results.push_back(as_scalar(z.value()));
+    cg.revert();
+    BOOST_CHECK_EQUAL(used, fxs->used());
+  }
+  BOOST_CHECK_CLOSE(results[0], results[1], 0.0001);
+  BOOST_CHECK_CLOSE(results[0], y_value, 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE( shrink_after_large_graph ) {
+  dynet::Model mod;
+  dynet::Parameter param = mod.add_parameters({512,512});
+  AlignedMemoryPool* fxs = default_device->pool(DeviceMempool::FXS);
+  size_t large_capacity = 0;
+  for (size_t i = 0; i < 12; ++i) {
+    dynet::ComputationGraph cg;
+    Expression x = parameter(cg, param);
+    // only the first graph needs more memory than the pool started with
+    Expression z = (i == 0 ? squared_norm(tanh(x) + tanh(-x) + x) : squared_norm(x));
+    cg.forward(z);
+    if (i == 0) large_capacity = fxs->capacity();
+  }
+  BOOST_CHECK_LT(fxs->capacity(), large_capacity);
+}
+
+BOOST_AUTO_TEST_CASE( grow_with_autobatching ) {
+  dynet::Model mod;
+  vector<dynet::Parameter> params;
+  vector<vector<float> > initial;
+  // sizes for which the scratch memory that sums the gradients of the two
+  // uses of a parameter does not fit in the segment of the planned gradients
+  for (size_t i = 0; i < 3; ++i) {
+    params.push_back(mod.add_parameters({256,500}));
+    initial.push_back(as_vector(params.back().get()->values));
+  }
+  AlignedMemoryPool* fxs = default_device->pool(DeviceMempool::FXS);
+  AlignedMemoryPool* dedfs = default_device->pool(DeviceMempool::DEDFS);
+  // --dynet-mem 3 gives each pool 1MB to start with
+  const size_t initial_cap = 1 << 20;
+  vector<vector<float> > losses(2), updated(2);
+  // autobatching runs first, so that it is the one that grows the pools
+  for (int strategy : {1, 0}) {
+    dynet::autobatch_flag = strategy;
+    for (size_t i = 0; i < params.size(); ++i)
+      TensorTools::set_elements(params[i].get()->values, initial[i]);
+    SimpleSGDTrainer trainer(mod);
+    vector<size_t> dedfs_used;
+    for (size_t r = 0; r < 2; ++r) {
+      dynet::ComputationGraph cg;
+      vector<Expression> ys;
+      for (auto & p : params)
+        ys.push_back(squared_norm(tanh(parameter(cg, p)) + parameter(cg, p)));
+      Expression z = sum(ys);
+      losses[strategy].push_back(as_scalar(cg.forward(z)));
+      // the forward values of the batches do not fit in the initial pool
+      BOOST_CHECK_GT(fxs->capacity(), initial_cap);
+      cg.backward(z);
+      dedfs_used.push_back(dedfs->used());
+      trainer.update(0.1);
+    }
+    // the first backward grows the gradient pool, and releases the scratch
+    // memory across segments, the second one runs in the merged pool
+    BOOST_CHECK_EQUAL(dedfs_used[0], dedfs_used[1]);
+    for (auto & p : params) {
+      vector<float> v = as_vector(p.get()->values);
+      updated[strategy].insert(updated[strategy].end(), v.begin(), v.end());
+    }
+  }
+  dynet::autobatch_flag = 0;
+  for (size_t r = 0; r < 2; ++r)
+    BOOST_CHECK_CLOSE(losses[0][r], losses[1][r], 0.001);
+  for (size_t k = 0; k < updated[0].size(); ++k)
+    BOOST_CHECK_SMALL(updated[0][k] - updated[1][k], 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE( cpu_allocator_options ) {
+  CPUMemoryOptions opts;
+  opts.hugepages = 1;
+  opts.numa_interleave = true;
+  opts.first_touch = true;
+  CPUAllocator a(opts);
+  // memory is mapped zero, and a pool does not zero it again
+  AlignedMemoryPool pool("test memory", 1 << 20, &a);
+  float* v = static_cast<float*>(pool.allocate(1000 * sizeof(float)));
+  for (size_t i = 0; i < 1000; ++i)
+    BOOST_CHECK_EQUAL(v[i], 0.f);
+  // growing the pool maps more memory
+  float* w = static_cast<float*>(pool.allocate(2 << 20));
+  w[(1 << 19) - 1] = 1.f;
+  pool.free();
+  v = static_cast<float*>(pool.allocate(3 << 20));
+  v[0] = 1.f;
+}
+
+BOOST_AUTO_TEST_CASE( recycling_pool_coalescing ) {
+  CPUAllocator a;
+  AlignedMemoryPool pool("test memory", 1 << 20, &a);
+  RecyclingMemoryPool recycling(&pool);
+  char* x = static_cast<char*>(recycling.allocate(1024));
+  char* y = static_cast<char*>(recycling.allocate(1024));
+  char* z = static_cast<char*>(recycling.allocate(1024));
+  recycling.allocate(1024);
+  const size_t used = pool.used();
+  // the three released neighbours become one block that fits a larger value
+  recycling.release(x, 1024);
+  recycling.release(z, 1024);
+  recycling.release(y, 1024);
+  BOOST_CHECK_EQUAL(recycling.allocate(3072), (void*)x);
+  BOOST_CHECK_EQUAL(pool.used(), used);
+}
+
+BOOST_AUTO_TEST_CASE( memory_telemetry ) {
+  dynet::Model mod;
+  dynet::Parameter param = mod.add_parameters({256,256});
+  {
+    dynet::ComputationGraph cg;
+    reset_memory_peaks();
+    Expression x = parameter(cg, param);
+    Expression z = squared_norm(tanh(x));
+    cg.forward(z);
+    cg.backward(z);
+    auto bytes = memory_by_node_type(cg);
+    BOOST_CHECK_EQUAL(bytes["Tanh"], 256 * 256 * sizeof(float));
+    const PoolUsage fxs = memory_usage()[0].pools[(int)DeviceMempool::FXS];
+    BOOST_CHECK_GE(fxs.peak, 256 * 256 * sizeof(float));
+    BOOST_CHECK_GE(fxs.capacity, fxs.peak);
+  }
+  // the peak outlives the graph, and the recommendation covers it
+  const PoolUsage dedfs = memory_usage()[0].pools[(int)DeviceMempool::DEDFS];
+  BOOST_CHECK_GE(dedfs.peak, 2 * 256 * 256 * sizeof(float));
+  istringstream descriptor(recommend_mem_descriptor(0));
+  size_t fxs_mb = 0;
+  descriptor >> fxs_mb;
+  BOOST_CHECK_GE(fxs_mb << 20, memory_usage()[0].pools[(int)DeviceMempool::FXS].peak);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
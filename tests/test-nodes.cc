@@ -4,6 +4,9 @@
 #include <dynet/dynet.h>
 #include <dynet/expr.h>
 #include <dynet/grad-check.h>
+#include <dynet/graph.h>
+#include <dynet/nodes.h>
+#include <dynet/nodes-fused.h>
 #include <boost/test/unit_test.hpp>
 #include <stdexcept>
 
@@ -1611,6 +1614,125 @@ BOOST_AUTO_TEST_CASE( gradient_sanity_test ) {
 
 }
 
+// void graph_optimize(ComputationGraph* cg);
+BOOST_AUTO_TEST_CASE( fused_elementwise_gradient ) {
+  vector<float> values;
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    dynet::ComputationGraph cg;
+    Expression x1 = parameter(cg, param1);
+    Expression x2 = parameter(cg, param2);
+    Expression x3 = parameter(cg, param3);
+    // an LSTM-style cell update: both logistic gates, the tanh and the sum
+    // end up in a single node
+    Expression i = logistic(x1 + 1.f);
+    Expression f = logistic(-x2);
+    Expression c = cmult(i, tanh(x3)) + cmult(f, x1);
+    Expression y = softsign(square(c) * 0.5f) + rectify(x2);
+    Expression z = sum_elems(y);
+    if (fuse) {
+      unsigned n = cg.nodes.size();
+      graph_optimize(&cg);
+      BOOST_CHECK_EQUAL(cg.nodes.size(), n);
+      unsigned fused = 0;
+      for (auto node : cg.nodes)
+        fused += (dynamic_cast<FusedElementwise*>(node) != nullptr);
+      BOOST_CHECK_EQUAL(fused, 1);
+    }
+    values.push_back(as_scalar(z.value()));
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  BOOST_CHECK_CLOSE(values[0], values[1], 0.001);
+}
+
+// void graph_optimize(ComputationGraph* cg);
+BOOST_AUTO_TEST_CASE( fused_elementwise_blocks ) {
+  // more elements than one block of a FusedElementwise node
+  dynet::Model block_mod;
+  Parameter p1 = block_mod.add_parameters({700});
+  Parameter p2 = block_mod.add_parameters({700});
+  vector<vector<float> > values, grads1, grads2;
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    dynet::ComputationGraph cg;
+    Expression x1 = parameter(cg, p1);
+    Expression x2 = parameter(cg, p2);
+    Expression y = cmult(tanh(x1 * 0.5f), logistic(x2)) + square(x1);
+    Expression z = sum_elems(y);
+    if (fuse)
+      graph_optimize(&cg);
+    values.push_back(as_vector(y.value()));
+    block_mod.reset_gradient();
+    cg.backward(z);
+    grads1.push_back(as_vector(p1.get()->g));
+    grads2.push_back(as_vector(p2.get()->g));
+  }
+  for (size_t k = 0; k < values[0].size(); ++k) {
+    BOOST_CHECK_SMALL(values[0][k] - values[1][k], 1e-5f);
+    BOOST_CHECK_SMALL(grads1[0][k] - grads1[1][k], 1e-5f);
+    BOOST_CHECK_SMALL(grads2[0][k] - grads2[1][k], 1e-5f);
+  }
+}
+
+// void graph_optimize(ComputationGraph* cg, const std::vector<VariableIndex>& outputs);
+BOOST_AUTO_TEST_CASE( graph_optimize_merge_and_remove ) {
+  vector<float> values;
+  vector<vector<float> > h_values;
+  for (int optimize = 0; optimize < 2; ++optimize) {
+    dynet::ComputationGraph cg;
+    Expression x1 = parameter(cg, param1);
+    Expression x2 = parameter(cg, param2);
+    Expression x1_again = parameter(cg, param1);
+    Expression y = transpose(x1) * x2 + transpose(x1_again) * x2;
+    Expression unused = tanh(x2);
+    // h is requested, so it is not fused into its only consumer
+    Expression h = tanh(x1);
+    Expression z = sum_elems(y) + sum_elems(h * 2.f);
+    if (optimize) {
+      graph_optimize(&cg, {h.i, z.i});
+      // the second parameter node, transpose and product are merged into
+      // the first ones, and then removed with the unused node
+      unsigned removed = 0;
+      for (auto node : cg.nodes)
+        removed += !node->has_value();
+      BOOST_CHECK_EQUAL(removed, 4);
+      BOOST_CHECK_EQUAL(cg.parameter_nodes.size(), 2);
+      BOOST_CHECK_THROW(unused.value(), std::runtime_error);
+    }
+    values.push_back(as_scalar(z.value()));
+    h_values.push_back(as_vector(h.value()));
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  BOOST_CHECK_CLOSE(values[0], values[1], 0.001);
+  for (size_t k = 0; k < h_values[0].size(); ++k)
+    BOOST_CHECK_CLOSE(h_values[0][k], h_values[1][k], 0.001);
+}
+
+// void graph_optimize(ComputationGraph* cg, const std::vector<VariableIndex>& outputs);
+BOOST_AUTO_TEST_CASE( graph_optimize_select_side_information ) {
+  vector<unsigned> i0 = {0}, i1 = {1}, i2 = {2};
+  vector<float> values;
+  for (int optimize = 0; optimize < 2; ++optimize) {
+    dynet::ComputationGraph cg;
+    Expression x1 = parameter(cg, param_square1);
+    Expression rows = select_rows(x1, i0) - select_rows(x1, i1);
+    Expression cols = select_cols(x1, i0) - select_cols(x1, i1);
+    Expression same = select_cols(x1, i2) + select_cols(x1, i2);
+    // bound to pointers, the indices may change before the graph is rerun
+    Expression bound = select_cols(x1, &i2) - select_cols(x1, &i2);
+    Expression z = sum_elems(rows) + sum_elems(cols) + sum_elems(same) + sum_elems(bound);
+    if (optimize) {
+      graph_optimize(&cg, {z.i});
+      // of the eight selections, only the two of column 2 by value are merged
+      unsigned selections = 0;
+      for (auto node : cg.nodes)
+        selections += (dynamic_cast<SelectRows*>(node) != nullptr || dynamic_cast<SelectCols*>(node) != nullptr);
+      BOOST_CHECK_EQUAL(selections, 7);
+    }
+    values.push_back(as_scalar(z.value()));
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  BOOST_CHECK_CLOSE(values[0], values[1], 0.001);
+}
+
 // This just makes sure that nothing crashes
 BOOST_AUTO_TEST_CASE( random_gumbel_test ) {
   dynet::ComputationGraph cg;
@@ -3,6 +3,9 @@
 #include <dynet/dynet.h>
 #include <dynet/expr.h>
 #include <dynet/model.h>
+#include <dynet/devices.h>
+#include <dynet/globals.h>
+#include <dynet/training.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
@@ -94,5 +97,51 @@ BOOST_AUTO_TEST_CASE( scale_grad ) {
     BOOST_CHECK_CLOSE(0.5, rescaled_grad, 0.001);
 }
 
+BOOST_AUTO_TEST_CASE( free_parameter_memory ) {
+    AlignedMemoryPool* ps = default_device->pool(DeviceMempool::PS);
+    const size_t used = ps->used();
+    size_t model_used;
+    {
+        dynet::Model mod;
+        mod.add_parameters({100, 100});
+        mod.add_lookup_parameters(10, {50});
+        model_used = ps->used();
+    }
+    // A model of the same shapes reuses the memory of the destroyed one
+    {
+        dynet::Model mod;
+        mod.add_lookup_parameters(10, {50});
+        mod.add_parameters({100, 100});
+        BOOST_CHECK_EQUAL(model_used, ps->used());
+    }
+    // Released memory at the end of the pool can be used for any size
+    default_device->trim_parameter_memory();
+    BOOST_CHECK_LE(ps->used(), used);
+    {
+        dynet::Model mod;
+        mod.add_parameters({150, 50});
+        BOOST_CHECK_LE(ps->used(), model_used);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( free_trainer_memory ) {
+    AlignedMemoryPool* ps = default_device->pool(DeviceMempool::PS);
+    default_device->trim_parameter_memory();
+    const size_t used = ps->used();
+    {
+        dynet::Model mod;
+        Parameter p = mod.add_parameters({10, 10});
+        LookupParameter lp = mod.add_lookup_parameters(10, {10});
+        AdamTrainer trainer(mod);
+        dynet::ComputationGraph cg;
+        Expression z = squared_norm(parameter(cg, p) * lookup(cg, lp, 1));
+        cg.backward(z);
+        trainer.update();
+        BOOST_CHECK_GT(ps->used(), used);
+    }
+    // The model and the moments of the trainer are all given back
+    default_device->trim_parameter_memory();
+    BOOST_CHECK_EQUAL(ps->used(), used);
+}
 
 BOOST_AUTO_TEST_SUITE_END()